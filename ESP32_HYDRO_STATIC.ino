@@ -40,6 +40,8 @@
 #include <Adafruit_INA219.h>
 #include <Adafruit_GFX.h>
 #include <Adafruit_SSD1306.h>
+#include "sensor_filter.h"
+#include "depth_calibration.h"
 
 // ===== BOARD VERSION SELECTION =====
 // Uncomment ONE of these based on your Heltec board version:
@@ -66,14 +68,42 @@
 // Soil Moisture Sensor pin (LM393 analog output)
 #ifdef HELTEC_V2
   #define MOISTURE_SENSOR_PIN 36  // V2: Use GPIO36 (ADC1_CH0, input only)
+  #define MOISTURE_POWER_PIN  13  // V2: LM393 VCC (MOISTURE_POWER_GATING)
 #elif defined(HELTEC_V3)
   #define MOISTURE_SENSOR_PIN 4   // V3: Use GPIO4 (ADC1)
+  #define MOISTURE_POWER_PIN  6   // V3: LM393 VCC (MOISTURE_POWER_GATING)
+#endif
+
+// ===== MOISTURE ACQUISITION MODE =====
+// true  = one continuous (DMA) ADC frame of MOISTURE_DMA_CONVERSIONS samples,
+//         averaged by the ADC driver and collected when the frame completes
+// false = MOISTURE_SAMPLE_COUNT analogRead() samples spaced 10 ms apart
+#define MOISTURE_DMA_ADC true
+
+// ===== MOISTURE PROBE POWER =====
+// true  = LM393 VCC is driven from MOISTURE_POWER_PIN and only switched on
+//         for each sampling window (less idle current, less probe corrosion)
+// false = LM393 VCC on 3.3V full time
+#define MOISTURE_POWER_GATING true
+
+// ===== SHARED I2C BUS (V2) =====
+// true  = the OLED frame is sent one 128-byte page at a time from loop(),
+//         only when no INA219 read is due within OLED_PAGE_GUARD_MS and
+//         only for pages that changed, so a redraw never delays a sample
+// false = display.display() sends the whole 1 KB frame at once
+// The V2 board has the INA219 and OLED on the same pins; V3 has two buses.
+#ifdef HELTEC_V2
+  #define OLED_PAGED_FLUSH true
+#else
+  #define OLED_PAGED_FLUSH false
 #endif
 
 // OLED display parameters
 #define SCREEN_WIDTH 128
 #define SCREEN_HEIGHT 64
 #define SCREEN_ADDRESS 0x3C  // I2C address for Heltec built-in OLED
+#define OLED_PAGES (SCREEN_HEIGHT / 8)
+#define I2C_CLOCK_HZ 400000  // OLED and INA219 both support fast mode
 
 // Create device instances
 #ifdef HELTEC_V3
@@ -81,7 +111,9 @@
 #endif
 
 Adafruit_INA219 ina219;  // Will be initialized with appropriate bus in setup()
-Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RST);
+// Bus stays at I2C_CLOCK_HZ between OLED transfers (the library default
+// drops back to 100 kHz, which would slow shared-bus INA219 reads)
+Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RST, I2C_CLOCK_HZ, I2C_CLOCK_HZ);
 
 // Flag to track if INA219 is available
 bool ina219Available = false;
@@ -91,12 +123,50 @@ unsigned long lastMoistureReadTime = 0;
 int lastMoistureRaw = 0;
 float lastMoisturePercent = 0.0;
 
+// Measurement cycle timing
+unsigned long nextCycleTime = 0;    // Start of the next measurement cycle
+bool cyclePending = false;          // Samplers running, results not shown yet
+
+// Non-blocking sampler state
+// loop() never waits on the sensors: each pass takes at most one reading
+// per channel, and finished averages are published for reportReading()
+bool currentSampling = false;
+int currentSampleIndex = 0;
+SensorFilter currentFilter;          // Filters loop current in microamps
+unsigned long nextCurrentSampleTime = 0;
+float lastCurrent = 0.0;
+
+bool moistureSampling = false;
+int moistureSampleIndex = 0;
+long moistureTotal = 0;
+unsigned long nextMoistureSampleTime = 0;
+unsigned long moistureCycleStart = 0;
+bool moistureDmaActive = false;               // Continuous ADC frame in progress
+volatile bool moistureFrameReady = false;     // Set by ADC driver when frame is done
+bool moistureSettling = false;                // Probe powered, waiting MOISTURE_SETTLE_MS
+
+// Paged OLED flush (OLED_PAGED_FLUSH)
+// oledShadow holds what the panel shows; pages that differ from the frame
+// buffer are sent by serviceDisplayFlush() between sensor transactions
+uint8_t oledShadow[SCREEN_WIDTH * OLED_PAGES];
+uint8_t oledNextPage = 0;                       // Round-robin scan position
+const uint8_t OLED_CHUNK_BYTES = 32;            // Data bytes per I2C write (fits any Wire buffer)
+const unsigned long OLED_PAGE_GUARD_MS = 5;     // One page takes ~3.5 ms at 400 kHz
+
+// Continuous ADC frame complete (called from the ADC driver)
+void ARDUINO_ISR_ATTR onMoistureFrame() {
+  moistureFrameReady = true;
+}
+
 // Sensor calibration parameters
-// Adjust these based on your tank specifications
+// Depth comes from the calibration table in depth_calibration.h: set
+// CAL_DEFAULT_FULL_MM to your tank depth, or capture a multi-point table
+// over serial with "CAL ADD <cm>" and "CAL SAVE"
 const float MIN_CURRENT_MA = 4.0;      // Minimum current (mA) at 0 depth
 const float MAX_CURRENT_MA = 20.0;     // Maximum current (mA) at max depth
-const float MAX_DEPTH_CM = 100.0;      // Maximum tank depth in centimeters
-                                       // Change this to match your tank
+
+// Active depth calibration (compile-time default or loaded from NVS)
+CalTable depthCal;
 
 // Unit conversion constants
 const float CM_TO_INCHES = 0.393701;   // Conversion factor from cm to inches
@@ -104,6 +174,8 @@ const float CM_TO_INCHES = 0.393701;   // Conversion factor from cm to inches
 // Measurement settings
 const int SAMPLE_COUNT = 10;           // Number of samples to average
 const unsigned long SAMPLE_DELAY_MS = 100;  // Delay between samples
+const unsigned long MEASUREMENT_INTERVAL_MS = 10000;  // Start a new reading every 10 seconds
+const uint8_t CURRENT_FILTER_SHIFT = 2;  // EWMA smoothing, alpha = 1/4 (see sensor_filter.h)
 
 // Soil moisture sensor settings
 // These values may need calibration for your specific sensor
@@ -111,7 +183,12 @@ const unsigned long SAMPLE_DELAY_MS = 100;  // Delay between samples
 const int MOISTURE_DRY_VALUE = 4095;   // ADC reading when sensor is dry
 const int MOISTURE_WET_VALUE = 1500;   // ADC reading when sensor is in water
 const int MOISTURE_SAMPLE_COUNT = 5;   // Number of samples to average
+const unsigned long MOISTURE_SAMPLE_DELAY_MS = 10;      // Delay between samples
 const unsigned long MOISTURE_READ_INTERVAL_MS = 10000;  // Read moisture every 10 seconds
+const uint32_t MOISTURE_DMA_CONVERSIONS = 256;         // Samples decimated into one reading
+const uint32_t MOISTURE_DMA_SAMPLE_HZ = 20000;          // 256 samples in ~13 ms
+const unsigned long MOISTURE_DMA_TIMEOUT_MS = 200;      // Give up on a frame after this
+const unsigned long MOISTURE_SETTLE_MS = 100;          // Probe power-on to first sample
 
 void setup() {
   Serial.begin(115200);
@@ -134,8 +211,11 @@ void setup() {
     Serial.println("I2C: OLED on GPIO17/18, INA219 on GPIO1/2");
   #else
     // V2: Shared I2C bus
-    Wire.begin(OLED_SDA, OLED_SCL);           // Both on same bus
-    Serial.println("I2C: Shared bus on GPIO4/15");
+    Wire.begin(OLED_SDA, OLED_SCL, I2C_CLOCK_HZ);  // Both on same bus
+    Serial.println("I2C: Shared bus on GPIO4/15 @ 400 kHz");
+    #if OLED_PAGED_FLUSH
+      Serial.println("OLED: paged flush, sensor reads take priority");
+    #endif
   #endif
 
   // Initialize OLED reset pin (required for Heltec boards)
@@ -160,6 +240,7 @@ void setup() {
   } else {
     Serial.println("INA219 initialized successfully");
     ina219Available = true;
+    filterInit(&currentFilter, CURRENT_FILTER_SHIFT);
   }
 
   // Initialize the OLED display
@@ -173,6 +254,11 @@ void setup() {
 
   Serial.println("Built-in OLED display initialized successfully");
 
+  // Load depth calibration (send "CAL" over serial to view or capture)
+  if (calLoad(&depthCal)) {
+    Serial.println("Depth calibration loaded from NVS");
+  }
+
   // Initialize soil moisture sensor pin
   pinMode(MOISTURE_SENSOR_PIN, INPUT);
   #ifdef HELTEC_V3
@@ -185,6 +271,13 @@ void setup() {
     Serial.println(MOISTURE_SENSOR_PIN);
   #endif
 
+  #if MOISTURE_POWER_GATING
+    pinMode(MOISTURE_POWER_PIN, OUTPUT);
+    digitalWrite(MOISTURE_POWER_PIN, LOW);
+    Serial.print("Moisture probe power gated on GPIO");
+    Serial.println(MOISTURE_POWER_PIN);
+  #endif
+
   // Display startup screen
   display.clearDisplay();
   display.setTextSize(1);
@@ -195,10 +288,11 @@ void setup() {
   display.println();
   display.println("Initializing...");
   display.display();
+  memcpy(oledShadow, display.getBuffer(), sizeof(oledShadow));
   delay(2000);
   Serial.println();
   Serial.print("Tank depth range: 0 - ");
-  Serial.print(MAX_DEPTH_CM);
+  Serial.print(calFullScaleMm(depthCal) / 10.0, 1);
   Serial.println(" cm");
   Serial.print("Current range: ");
   Serial.print(MIN_CURRENT_MA);
@@ -209,29 +303,64 @@ void setup() {
   Serial.println("Starting measurements...");
   Serial.println("=====================================");
   Serial.println();
+
+  nextCycleTime = millis();
 }
 
 void loop() {
+  unsigned long now = millis();
+
+  // Start each measurement cycle on a fixed MEASUREMENT_INTERVAL_MS step so
+  // the period no longer stretches with sampling and display time
+  if (!cyclePending && (long)(now - nextCycleTime) >= 0) {
+    if (ina219Available) {
+      startCurrentSampling(now);
+    }
+
+    // Read soil moisture sensor (only every MOISTURE_READ_INTERVAL_MS)
+    if (nextCycleTime - lastMoistureReadTime >= MOISTURE_READ_INTERVAL_MS || lastMoistureReadTime == 0) {
+      startMoistureSampling(now);
+      lastMoistureReadTime = nextCycleTime;
+    }
+
+    cyclePending = true;
+    nextCycleTime += MEASUREMENT_INTERVAL_MS;
+    if ((long)(now - nextCycleTime) >= 0) {
+      nextCycleTime = now + MEASUREMENT_INTERVAL_MS;  // Fell a whole cycle behind - resync
+    }
+  }
+
+  serviceCurrentSampling(now);
+  serviceMoistureSampling(now);
+  serviceSerialCommands();
+  serviceDisplayFlush(now);
+
+  // Report once every sampler started this cycle has published
+  if (cyclePending && !currentSampling && !moistureSampling) {
+    cyclePending = false;
+    reportReading();
+  }
+
+  delay(1);
+}
+
+/**
+ * Print and display the most recently published readings
+ * Called once per measurement cycle after all samplers have finished
+ */
+void reportReading() {
   float avgCurrent = 0.0;
   float depthCm = 0.0;
   float depthInches = 0.0;
   float depthPercent = 0.0;
 
-  // Read INA219 if available
   if (ina219Available) {
-    avgCurrent = getAverageCurrent();
+    avgCurrent = lastCurrent;
     depthCm = calculateDepth(avgCurrent);
     depthInches = depthCm * CM_TO_INCHES;
     depthPercent = calculatePercentage(avgCurrent);
   }
 
-  // Read soil moisture sensor (only every MOISTURE_READ_INTERVAL_MS)
-  unsigned long currentTime = millis();
-  if (currentTime - lastMoistureReadTime >= MOISTURE_READ_INTERVAL_MS || lastMoistureReadTime == 0) {
-    lastMoistureRaw = getAverageMoisture();
-    lastMoisturePercent = calculateMoisturePercent(lastMoistureRaw);
-    lastMoistureReadTime = currentTime;
-  }
   int moistureRaw = lastMoistureRaw;
   float moisturePercent = lastMoisturePercent;
 
@@ -281,79 +410,188 @@ void loop() {
 
   // Update OLED display
   updateOLEDDisplay(avgCurrent, depthInches, depthPercent, moisturePercent, ina219Available);
-
-  // Wait before next reading
-  delay(10000);
 }
 
 /**
- * Read multiple current samples and return the average
- * This reduces noise and provides more stable readings
+ * Begin a new INA219 averaging cycle
+ * Samples are taken by serviceCurrentSampling() as loop() runs
  */
-float getAverageCurrent() {
-  float total = 0.0;
+void startCurrentSampling(unsigned long now) {
+  currentSampleIndex = 0;
+  nextCurrentSampleTime = now;
+  currentSampling = true;
+}
 
-  for (int i = 0; i < SAMPLE_COUNT; i++) {
-    float current_mA = ina219.getCurrent_mA();
+/**
+ * Take the next current sample if one is due
+ * Each sample goes through the median + EWMA filter so a single glitchy
+ * 4-20 mA reading cannot skew the result. Publishes the filter output to
+ * lastCurrent after SAMPLE_COUNT samples.
+ * Returns true when a new value has been published
+ */
+bool serviceCurrentSampling(unsigned long now) {
+  if (!currentSampling || (long)(now - nextCurrentSampleTime) < 0) return false;
 
-    // INA219 may return negative values depending on current direction
-    // Take absolute value to ensure positive reading
-    current_mA = abs(current_mA);
+  float current_mA = ina219.getCurrent_mA();
 
-    total += current_mA;
+  // INA219 may return negative values depending on current direction
+  // Take absolute value to ensure positive reading
+  filterUpdate(&currentFilter, lroundf(abs(current_mA) * 1000.0));
+  currentSampleIndex++;
 
-    if (i < SAMPLE_COUNT - 1) {
-      delay(SAMPLE_DELAY_MS);
-    }
+  if (currentSampleIndex < SAMPLE_COUNT) {
+    nextCurrentSampleTime += SAMPLE_DELAY_MS;
+    return false;
   }
 
-  return total / SAMPLE_COUNT;
+  lastCurrent = filterValue(&currentFilter) / 1000.0;
+  currentSampling = false;
+  return true;
 }
 
 /**
  * Convert current (mA) to water depth (cm)
- * Uses linear interpolation:
- *   4 mA  -> 0 cm
- *   20 mA -> MAX_DEPTH_CM
+ * Uses the piecewise-linear calibration table (integer interpolation
+ * between calibrated points, clamped at the table ends)
  */
 float calculateDepth(float current_mA) {
-  // Constrain current to valid range
-  current_mA = constrain(current_mA, MIN_CURRENT_MA, MAX_CURRENT_MA);
-
-  // Linear mapping from current to depth
-  float depth = ((current_mA - MIN_CURRENT_MA) / (MAX_CURRENT_MA - MIN_CURRENT_MA)) * MAX_DEPTH_CM;
-
-  return depth;
+  return calDepthMm(depthCal, lroundf(current_mA * 1000.0)) / 10.0;
 }
 
 /**
  * Convert current (mA) to percentage of tank capacity
- *   4 mA  -> 0%
- *   20 mA -> 100%
+ *   Calibrated depth as a fraction of the table's full-scale depth
  */
 float calculatePercentage(float current_mA) {
-  // Constrain current to valid range
-  current_mA = constrain(current_mA, MIN_CURRENT_MA, MAX_CURRENT_MA);
+  return calculateDepth(current_mA) * 1000.0 / calFullScaleMm(depthCal);
+}
 
-  // Linear mapping from current to percentage
-  float percentage = ((current_mA - MIN_CURRENT_MA) / (MAX_CURRENT_MA - MIN_CURRENT_MA)) * 100.0;
+/**
+ * Read serial commands without blocking (one line at a time)
+ * See depth_calibration.h for the CAL commands
+ */
+void serviceSerialCommands() {
+  static char line[48];
+  static uint8_t len = 0;
+
+  while (Serial.available()) {
+    char c = Serial.read();
+    if (c == '\r' || c == '\n') {
+      if (len == 0) continue;
+      line[len] = '\0';
+      len = 0;
+      if (!calHandleCommand(&depthCal, line, ina219Available ? lroundf(lastCurrent * 1000.0) : -1)) {
+        Serial.print("Unknown command: ");
+        Serial.println(line);
+      }
+    } else if (len < sizeof(line) - 1) {
+      line[len++] = toupper(c);
+    }
+  }
+}
 
-  return percentage;
+/**
+ * Begin a new soil moisture averaging cycle
+ * Samples are taken by serviceMoistureSampling() as loop() runs
+ */
+void startMoistureSampling(unsigned long now) {
+  moistureTotal = 0;
+  moistureSampleIndex = 0;
+  nextMoistureSampleTime = now;
+  moistureCycleStart = now;
+  moistureSampling = true;
+
+  #if MOISTURE_POWER_GATING
+    // Power the probe and let its output settle before the first sample
+    setMoistureProbePower(true);
+    moistureSettling = true;
+    nextMoistureSampleTime = now + MOISTURE_SETTLE_MS;
+  #else
+    beginMoistureAcquisition(now);
+  #endif
+}
+
+/**
+ * Start the ADC side of a moisture reading once the probe is powered
+ */
+void beginMoistureAcquisition(unsigned long now) {
+  nextMoistureSampleTime = now;
+  moistureCycleStart = now;
+
+  #if MOISTURE_DMA_ADC
+    // The ADC driver fills one DMA frame and averages it without the CPU;
+    // if continuous mode can't start, this cycle falls back to analogRead()
+    static const uint8_t moisturePins[] = { MOISTURE_SENSOR_PIN };
+    moistureFrameReady = false;
+    moistureDmaActive = analogContinuous(moisturePins, 1, MOISTURE_DMA_CONVERSIONS,
+                                         MOISTURE_DMA_SAMPLE_HZ, &onMoistureFrame) &&
+                        analogContinuousStart();
+    if (!moistureDmaActive) {
+      Serial.println("Continuous ADC failed - using analogRead()");
+      analogContinuousDeinit();
+    }
+  #endif
+}
+
+/**
+ * Switch the LM393 supply (no-op unless MOISTURE_POWER_GATING)
+ */
+void setMoistureProbePower(bool on) {
+  #if MOISTURE_POWER_GATING
+    digitalWrite(MOISTURE_POWER_PIN, on ? HIGH : LOW);
+  #endif
 }
 
 /**
- * Read multiple soil moisture samples and return the average
- * This reduces noise from the analog sensor
+ * Take the next soil moisture sample if one is due
+ * Publishes raw and percentage values after MOISTURE_SAMPLE_COUNT samples
+ * Returns true when a new average has been published
  */
-int getAverageMoisture() {
-  long total = 0;
+bool serviceMoistureSampling(unsigned long now) {
+  if (!moistureSampling || (long)(now - nextMoistureSampleTime) < 0) return false;
 
-  for (int i = 0; i < MOISTURE_SAMPLE_COUNT; i++) {
-    total += analogRead(MOISTURE_SENSOR_PIN);
-    delay(10);
+  if (moistureSettling) {
+    moistureSettling = false;
+    beginMoistureAcquisition(now);
+    return false;
   }
 
-  return total / MOISTURE_SAMPLE_COUNT;
+  #if MOISTURE_DMA_ADC
+    if (moistureDmaActive) {
+      if (!moistureFrameReady && now - moistureCycleStart < MOISTURE_DMA_TIMEOUT_MS) return false;
+
+      adc_continuous_data_t* result = NULL;
+      if (moistureFrameReady && analogContinuousRead(&result, 0)) {
+        lastMoistureRaw = result[0].avg_read_raw;
+      } else {
+        Serial.println("Moisture ADC frame timeout - keeping last reading");
+      }
+
+      // Release the ADC unit between readings
+      analogContinuousStop();
+      analogContinuousDeinit();
+      moistureDmaActive = false;
+
+      lastMoisturePercent = calculateMoisturePercent(lastMoistureRaw);
+      setMoistureProbePower(false);
+      moistureSampling = false;
+      return true;
+    }
+  #endif
+
+  moistureTotal += analogRead(MOISTURE_SENSOR_PIN);
+  moistureSampleIndex++;
+
+  if (moistureSampleIndex < MOISTURE_SAMPLE_COUNT) {
+    nextMoistureSampleTime += MOISTURE_SAMPLE_DELAY_MS;
+    return false;
+  }
+
+  lastMoistureRaw = moistureTotal / MOISTURE_SAMPLE_COUNT;
+  lastMoisturePercent = calculateMoisturePercent(lastMoistureRaw);
+  setMoistureProbePower(false);
+  moistureSampling = false;
+  return true;
 }
 
 /**
@@ -450,5 +688,61 @@ void updateOLEDDisplay(float current_mA, float depthInches, float percentage, fl
   }
 
   // Display everything
-  display.display();
+  #if !OLED_PAGED_FLUSH
+    display.display();
+  #endif
+}
+
+/**
+ * Send at most one changed OLED page to the panel
+ * Sensor reads own the shared bus: a page (~3.5 ms at 400 kHz) is only
+ * started when no INA219 sample or cycle start (whose first sample is
+ * immediate) is due within OLED_PAGE_GUARD_MS, so the sample schedule is
+ * the same whether or not the display is redrawing.
+ * A frame drawn mid-flush just changes which pages still differ.
+ */
+void serviceDisplayFlush(unsigned long now) {
+  #if OLED_PAGED_FLUSH
+    if (currentSampling && (long)(nextCurrentSampleTime - now) < (long)OLED_PAGE_GUARD_MS) return;
+    if (!cyclePending && (long)(nextCycleTime - now) < (long)OLED_PAGE_GUARD_MS) return;
+
+    const uint8_t* buffer = display.getBuffer();
+    for (uint8_t n = 0; n < OLED_PAGES; n++) {
+      uint8_t page = oledNextPage;
+      oledNextPage = (oledNextPage + 1) % OLED_PAGES;
+
+      const uint8_t* src = buffer + page * SCREEN_WIDTH;
+      uint8_t* shadow = oledShadow + page * SCREEN_WIDTH;
+      if (memcmp(src, shadow, SCREEN_WIDTH) == 0) continue;
+
+      if (writeOLEDPage(page, src)) {
+        memcpy(shadow, src, SCREEN_WIDTH);
+      }
+      return;
+    }
+  #endif
+}
+
+/**
+ * Write one 128-column page: address window, then the data in
+ * OLED_CHUNK_BYTES transactions
+ */
+bool writeOLEDPage(uint8_t page, const uint8_t* data) {
+  Wire.beginTransmission(SCREEN_ADDRESS);
+  Wire.write((uint8_t)0x00);  // Command stream
+  Wire.write((uint8_t)SSD1306_PAGEADDR);
+  Wire.write(page);
+  Wire.write(page);
+  Wire.write((uint8_t)SSD1306_COLUMNADDR);
+  Wire.write((uint8_t)0);
+  Wire.write((uint8_t)(SCREEN_WIDTH - 1));
+  if (Wire.endTransmission() != 0) return false;
+
+  for (uint8_t col = 0; col < SCREEN_WIDTH; col += OLED_CHUNK_BYTES) {
+    Wire.beginTransmission(SCREEN_ADDRESS);
+    Wire.write((uint8_t)0x40);  // Data stream
+    Wire.write(data + col, OLED_CHUNK_BYTES);
+    if (Wire.endTransmission() != 0) return false;
+  }
+  return true;
 }
@@ -0,0 +1,123 @@
+/*
+ * Battery Gauge - LiPo state of charge and runtime estimate
+ *
+ * Used by the river unit. The copy in river_unit/ must match this file.
+ *
+ * Two estimates are fused on every update:
+ *   1. Open-circuit voltage: the terminal voltage plus the IR drop of the
+ *      present load (load_mA x internal resistance), looked up in a LiPo
+ *      OCV curve. Accurate at the ends, flat and noisy mid-range.
+ *   2. Coulomb counting: the charge drawn since the last update, taken
+ *      from the capacity. Smooth, but drifts without a reference.
+ * The counted state of charge is pulled 1 / 2^BAT_OCV_CORRECT_SHIFT of the
+ * way toward the OCV estimate each update, so the voltage corrects the
+ * drift while the count rides out load noise.
+ *
+ * The runtime estimate is the remaining charge over a smoothed average
+ * draw (mA, same EWMA form as sensor_filter.h).
+ */
+
+#ifndef BATTERY_GAUGE_H
+#define BATTERY_GAUGE_H
+
+#include <stdint.h>
+
+#define BAT_OCV_POINTS          12
+#define BAT_OCV_CORRECT_SHIFT   4      // OCV correction alpha = 1/16
+#define BAT_LOAD_SHIFT          3      // Average draw alpha = 1/8
+
+typedef struct {
+  int32_t mV;        // Resting cell voltage
+  int32_t permille;  // State of charge at that voltage (0.1 %)
+} OcvPoint;
+
+// Typical single-cell LiPo at rest, 25 C (sorted by increasing voltage)
+constexpr OcvPoint BAT_OCV_TABLE[BAT_OCV_POINTS] = {
+  { 3000,    0 }, { 3450,   50 }, { 3680,  100 }, { 3740,  200 },
+  { 3770,  300 }, { 3790,  400 }, { 3820,  500 }, { 3870,  600 },
+  { 3920,  700 }, { 3980,  800 }, { 4060,  900 }, { 4200, 1000 }
+};
+
+constexpr bool batOcvValid() {
+  for (uint8_t i = 1; i < BAT_OCV_POINTS; i++) {
+    if (BAT_OCV_TABLE[i].mV <= BAT_OCV_TABLE[i - 1].mV) return false;
+    if (BAT_OCV_TABLE[i].permille < BAT_OCV_TABLE[i - 1].permille) return false;
+  }
+  return true;
+}
+
+static_assert(batOcvValid(), "LiPo OCV table must be sorted by voltage");
+
+// State of charge (0.1 %) for a resting cell voltage, clamped to the table ends
+constexpr int32_t batOcvPermille(int32_t mV) {
+  if (mV <= BAT_OCV_TABLE[0].mV) return BAT_OCV_TABLE[0].permille;
+
+  for (uint8_t i = 1; i < BAT_OCV_POINTS; i++) {
+    const OcvPoint& hi = BAT_OCV_TABLE[i];
+    if (mV <= hi.mV) {
+      const OcvPoint& lo = BAT_OCV_TABLE[i - 1];
+      return lo.permille + (mV - lo.mV) * (hi.permille - lo.permille) / (hi.mV - lo.mV);
+    }
+  }
+
+  return BAT_OCV_TABLE[BAT_OCV_POINTS - 1].permille;
+}
+
+static_assert(batOcvPermille(3845) == 550, "LiPo OCV interpolation is off");
+
+typedef struct {
+  bool    primed;        // Holds an estimate
+  float   soc;           // Fused state of charge (0..1)
+  float   avgLoad_mA;    // Smoothed average draw
+  int32_t terminal_mV;   // Last measured terminal voltage
+  int32_t ocv_mV;        // Last load-compensated open-circuit voltage
+} BatteryGauge;
+
+inline void batteryReset(BatteryGauge* g) {
+  g->primed = false;
+  g->soc = 0;
+  g->avgLoad_mA = 0;
+  g->terminal_mV = 0;
+  g->ocv_mV = 0;
+}
+
+// Add one measurement.
+//   terminal_mV  battery voltage measured while load_mA was flowing
+//   charge_mAh   charge drawn since the previous update
+//   elapsed_h    time since the previous update
+inline void batteryUpdate(BatteryGauge* g, int32_t terminal_mV, float load_mA,
+                          float charge_mAh, float elapsed_h,
+                          uint16_t capacity_mAh, uint16_t internal_mOhm) {
+  // mA x mOhm = uV
+  g->terminal_mV = terminal_mV;
+  g->ocv_mV = terminal_mV + (int32_t)(load_mA * internal_mOhm / 1000.0f);
+  float ocvSoc = batOcvPermille(g->ocv_mV) / 1000.0f;
+
+  if (!g->primed) {
+    g->soc = ocvSoc;
+    g->avgLoad_mA = load_mA;
+    g->primed = true;
+    return;
+  }
+
+  g->soc -= charge_mAh / capacity_mAh;
+  g->soc += (ocvSoc - g->soc) / (1 << BAT_OCV_CORRECT_SHIFT);
+  if (g->soc < 0) g->soc = 0;
+  if (g->soc > 1) g->soc = 1;
+
+  if (elapsed_h > 0) {
+    g->avgLoad_mA += (charge_mAh / elapsed_h - g->avgLoad_mA) / (1 << BAT_LOAD_SHIFT);
+  }
+}
+
+inline uint8_t batteryPercent(const BatteryGauge* g) {
+  return (uint8_t)(g->soc * 100.0f + 0.5f);
+}
+
+// Hours left at the average draw (0 if unknown)
+inline float batteryRuntimeHours(const BatteryGauge* g, uint16_t capacity_mAh) {
+  if (!g->primed || g->avgLoad_mA <= 0) return 0;
+  return g->soc * capacity_mAh / g->avgLoad_mA;
+}
+
+#endif // BATTERY_GAUGE_H
@@ -0,0 +1,162 @@
+/*
+ * Conversion Tables - Stage to discharge and depth to tank volume
+ *
+ * Shared by every unit that shows derived quantities. The copy in
+ * home_unit/ must match this file.
+ *
+ * Both conversions are piecewise-linear lookups in a table held in flash,
+ * the same integer interpolation depth_calibration.h uses, so a reading
+ * costs a short table walk instead of pow()/acos()/sqrt() at runtime:
+ *
+ *   RATING_TABLE  stage (mm) -> discharge (0.01 cfs)
+ *                 Copy the site's rating curve in here (USGS rating table,
+ *                 or your own current-meter measurements).
+ *   TANK_TABLE    depth (mm) -> stored volume (litres)
+ *                 Built at compile time from TANK_SHAPE: a horizontal
+ *                 cylinder's segment area is integrated numerically by a
+ *                 constexpr function; an irregular tank uses a strapping
+ *                 chart typed in below.
+ *
+ * Stage is the calibrated depth plus RATING_STAGE_OFFSET_MM (the gauge
+ * height of the sensor's zero), so the rating curve can use the site's own
+ * gauge datum.
+ */
+
+#ifndef CONVERSION_TABLES_H
+#define CONVERSION_TABLES_H
+
+#include <stdint.h>
+
+#define CONV_MAX_POINTS         17
+
+typedef struct {
+  int32_t x;   // Input (mm)
+  int32_t y;   // Output at this input
+} ConvPoint;
+
+typedef struct {
+  uint8_t   count;                     // Points in use (2..CONV_MAX_POINTS)
+  ConvPoint points[CONV_MAX_POINTS];   // Sorted by strictly increasing x
+} ConvTable;
+
+// A table is usable if it has 2+ points with strictly increasing input and
+// non-decreasing output (discharge and volume only grow with level)
+constexpr bool convValid(const ConvTable& t) {
+  if (t.count < 2 || t.count > CONV_MAX_POINTS) return false;
+  for (uint8_t i = 1; i < t.count; i++) {
+    if (t.points[i].x <= t.points[i - 1].x) return false;
+    if (t.points[i].y < t.points[i - 1].y) return false;
+  }
+  return true;
+}
+
+// Output for an input, clamped to the table ends
+constexpr int32_t convLookup(const ConvTable& t, int32_t x) {
+  if (x <= t.points[0].x) return t.points[0].y;
+
+  for (uint8_t i = 1; i < t.count; i++) {
+    const ConvPoint& hi = t.points[i];
+    if (x <= hi.x) {
+      const ConvPoint& lo = t.points[i - 1];
+      return lo.y + (int32_t)((int64_t)(x - lo.x) * (hi.y - lo.y) / (hi.x - lo.x));
+    }
+  }
+
+  return t.points[t.count - 1].y;
+}
+
+// ===== STAGE -> DISCHARGE (rating curve) =====
+
+#define RATING_STAGE_OFFSET_MM  150      // Gauge height at sensor zero
+
+// Example rating, Q = 25 (h - 0.15 m)^1.6 - replace with the site's curve
+constexpr ConvTable RATING_TABLE = {
+  13,
+  { {  150,     0 }, {  200,    21 }, {  300,   120 }, {  400,   272 },
+    {  500,   466 }, {  600,   697 }, {  800,  1255 }, { 1000,  1928 },
+    { 1250,  2912 }, { 1500,  4041 }, { 2000,  6690 }, { 2500,  9810 },
+    { 3000, 13356 } }
+};
+
+static_assert(convValid(RATING_TABLE), "Rating table is invalid");
+
+// Discharge (cfs) for a calibrated depth (mm)
+inline float ratingDischargeCfs(int32_t depth_mm) {
+  return convLookup(RATING_TABLE, depth_mm + RATING_STAGE_OFFSET_MM) / 100.0f;
+}
+
+// ===== DEPTH -> TANK VOLUME =====
+
+#define TANK_HORIZONTAL_CYLINDER  1
+#define TANK_IRREGULAR            2
+
+#define TANK_SHAPE              TANK_HORIZONTAL_CYLINDER
+#define TANK_DIAMETER_MM        1000     // Horizontal cylinder
+#define TANK_LENGTH_MM          2000
+
+constexpr double convSqrt(double v) {
+  if (v <= 0) return 0;
+  double r = v > 1 ? v : 1;
+  for (uint8_t i = 0; i < 60; i++) {
+    double next = 0.5 * (r + v / r);
+    if (next == r) break;
+    r = next;
+  }
+  return r;
+}
+
+// Filled fraction of a circle's area below height h (as a fraction of the
+// diameter). Midpoint sum of the chord width 2 * sqrt(y (1 - y)).
+constexpr double convSegmentFraction(double h) {
+  const int steps = 2000;
+  const double pi = 3.14159265358979323846;
+  double area = 0;
+  for (int i = 0; i < steps; i++) {
+    double y = h * (i + 0.5) / steps;
+    area += 2 * convSqrt(y * (1 - y)) * h / steps;
+  }
+  return area / (pi / 4);
+}
+
+constexpr ConvTable convHorizontalCylinder(int32_t diameter_mm, int32_t length_mm) {
+  const double pi = 3.14159265358979323846;
+  const double full_L = pi / 4 * diameter_mm * diameter_mm * length_mm / 1e6;
+  ConvTable t = { CONV_MAX_POINTS, {} };
+  for (uint8_t i = 0; i < CONV_MAX_POINTS; i++) {
+    double h = (double)i / (CONV_MAX_POINTS - 1);
+    t.points[i].x = (int32_t)(h * diameter_mm + 0.5);
+    t.points[i].y = (int32_t)(convSegmentFraction(h) * full_L + 0.5);
+  }
+  return t;
+}
+
+#if TANK_SHAPE == TANK_HORIZONTAL_CYLINDER
+constexpr ConvTable TANK_TABLE = convHorizontalCylinder(TANK_DIAMETER_MM, TANK_LENGTH_MM);
+
+static_assert(convLookup(TANK_TABLE, TANK_DIAMETER_MM / 2) * 2 -
+              TANK_TABLE.points[CONV_MAX_POINTS - 1].y <= 2 &&
+              TANK_TABLE.points[CONV_MAX_POINTS - 1].y -
+              convLookup(TANK_TABLE, TANK_DIAMETER_MM / 2) * 2 <= 2,
+              "Half-full cylinder should hold half its volume");
+#else
+// Strapping chart: depth (mm) -> litres, from the tank maker or by filling
+// with a metered hose
+constexpr ConvTable TANK_TABLE = {
+  5,
+  { { 0, 0 }, { 250, 300 }, { 500, 800 }, { 750, 1400 }, { 1000, 2000 } }
+};
+#endif
+
+static_assert(convValid(TANK_TABLE), "Tank table is invalid");
+
+// Stored volume (litres) for a calibrated depth (mm)
+inline int32_t tankVolumeLitres(int32_t depth_mm) {
+  return convLookup(TANK_TABLE, depth_mm);
+}
+
+// Fill level (0-100 %) by volume
+inline float tankFillPercent(int32_t depth_mm) {
+  return tankVolumeLitres(depth_mm) * 100.0f / TANK_TABLE.points[TANK_TABLE.count - 1].y;
+}
+
+#endif // CONVERSION_TABLES_H
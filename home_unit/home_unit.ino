@@ -9,6 +9,7 @@
  * Features:
  * - Receives relayed packets from ridge unit
  * - Displays water level, moisture, and signal quality
+ * - Optional river discharge (rating curve) or tank volume
  * - Serial output for computer logging
  * - Connection status indicator
  *
@@ -22,6 +23,10 @@
 #include <Adafruit_SSD1306.h>
 #include <RadioLib.h>
 #include "lora_config.h"
+#include "sensor_filter.h"
+#include "node_table.h"
+#include "depth_calibration.h"
+#include "conversion_tables.h"
 
 // OLED pins for V3
 #define OLED_SDA 17
@@ -34,12 +39,37 @@
 #define SCREEN_HEIGHT 64
 #define SCREEN_ADDRESS 0x3C
 
-// Sensor calibration (same as river unit for depth calculation)
+// Sensor calibration - depth comes from the depth_calibration.h table
+// (keep it matched to the river unit: "CAL ADD <mA> <cm>" over serial)
 const float MIN_CURRENT_MA = 4.0;
-const float MAX_CURRENT_MA = 20.0;
-const float MAX_DEPTH_CM = 100.0;
 const float CM_TO_INCHES = 0.393701;
 
+// Active depth calibration (compile-time default or loaded from NVS)
+CalTable depthCal;
+
+// ===== DERIVED QUANTITY =====
+// What the measured level means at this site (tables in conversion_tables.h)
+#define DERIVED_NONE    0   // Depth only
+#define DERIVED_FLOW    1   // River: discharge from the rating curve (cfs)
+#define DERIVED_VOLUME  2   // Tank: stored volume (US gallons)
+#define DERIVED_QUANTITY DERIVED_NONE
+
+const float LITRES_TO_GALLONS = 0.264172;
+
+// ===== BOOT =====
+// The radio starts listening first; the OLED powers up in reset meanwhile
+// and is initialised once Vext has settled, with no fixed waits.
+// true  = show the "Initializing..." splash for BOOT_SPLASH_MS
+#define BOOT_SPLASH false
+
+const unsigned long BOOT_SPLASH_MS = 2000;
+const unsigned long SERIAL_WAIT_MS = 1000;      // Max wait for a USB CDC host (UART is ready at once)
+const unsigned long OLED_POWER_UP_MS = 100;     // Vext on to first OLED command
+
+// Display smoothing (sensor_filter.h): median of the last 5 packets + EWMA
+// so one corrupted or glitchy reading does not jump the depth display
+const uint8_t DISPLAY_FILTER_SHIFT = 1;
+
 // Create device instances
 Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RST);
 
@@ -51,17 +81,13 @@ SX1262 radio = new Module(LORA_NSS, LORA_DIO1, LORA_RST, LORA_BUSY, loraSPI);
 bool loraInitialized = false;
 uint32_t packetsReceived = 0;
 uint32_t packetErrors = 0;
-unsigned long lastPacketTime = 0;
-uint8_t lastSequence = 0;
+unsigned long lastPacketTime = 0;    // Last reading from any node
 bool connectionActive = false;
+unsigned long setupDoneMs = 0;
 
-// Last received data
-float lastCurrent = 0;
-float lastMoisture = 0;
-int lastRSSI_River = 0;   // RSSI at ridge (river->ridge link)
-int lastRSSI_Home = 0;    // RSSI at home (ridge->home link)
-float lastSNR = 0;
-uint8_t lastBattery = 0;
+// Per-node sequence tracking, last values and link stats (node_table.h)
+NodeTable nodes;
+NodeEntry* displayNode = nullptr;   // Shown on the OLED: the last node heard
 
 // Interrupt flag for non-blocking receive
 volatile bool receivedFlag = false;
@@ -74,55 +100,75 @@ void setFlag(void) {
 // Function declarations
 bool initLoRa();
 void processPacket();
+NodeEntry* sourceNode(uint8_t sourceId);
+bool trackSequence(NodeEntry* node, uint8_t sequence);
+void processReading(NodeEntry* node, SensorPacket* pkt, int rssi, float snr);
+void storeReading(NodeEntry* node, SensorPacket* pkt, int rssi, float snr);
+void processDuplicate(NodeEntry* node, SensorPacket* pkt, int rssi, float snr);
+void processBatchPacket(const uint8_t* frame, size_t len, int rssi, float snr);
 float calculateDepth(float current_mA);
 float calculatePercentage(float current_mA);
+void printDerived(float current_mA);
 void updateDisplay();
+void serviceSerialCommands();
 void printSerialData(SensorPacket* pkt, int rssi, float snr);
+void processChannelPacket(uint8_t* frame, size_t len);
+void processStormPacket(uint8_t* frame, size_t len);
+void printNodeTable();
 
 void setup() {
   Serial.begin(115200);
-  delay(1000);
+
+  // Enable Vext power for OLED and hold it in reset - it settles while the
+  // radio starts
+  pinMode(VEXT_CTRL, OUTPUT);
+  digitalWrite(VEXT_CTRL, LOW);  // LOW = ON for Vext
+  pinMode(OLED_RST, OUTPUT);
+  digitalWrite(OLED_RST, LOW);
+  unsigned long vextOnMs = millis();
+
+  // USB CDC: give a host a moment to attach so the banner isn't lost
+  while (!Serial && millis() < SERIAL_WAIT_MS) delay(1);
 
   Serial.println();
   Serial.println("Home Unit - LoRa Receiver");
   Serial.println("=========================");
   Serial.println("Board: Heltec WiFi LoRa 32 V3");
 
-  // Enable Vext power for OLED
-  pinMode(VEXT_CTRL, OUTPUT);
-  digitalWrite(VEXT_CTRL, LOW);  // LOW = ON for Vext
-  delay(100);
+  nodeTableInit(&nodes);
 
-  // Initialize I2C for OLED
-  Wire.begin(OLED_SDA, OLED_SCL);
+  // Load depth calibration (send "CAL" over serial to view or edit)
+  if (calLoad(&depthCal)) {
+    Serial.println("Depth calibration loaded from NVS");
+  }
 
-  // Initialize OLED reset pin
-  pinMode(OLED_RST, OUTPUT);
-  digitalWrite(OLED_RST, LOW);
-  delay(50);
-  digitalWrite(OLED_RST, HIGH);
-  delay(100);
+  // Initialize LoRa and start listening before the display is up
+  loraInitialized = initLoRa();
+
+  if (loraInitialized) {
+    // Set up interrupt-driven receive
+    radio.setDio1Action(setFlag);
+
+    // Start listening
+    int state = radio.startReceive();
+    if (state != RADIOLIB_ERR_NONE) {
+      Serial.print("startReceive failed: ");
+      Serial.println(state);
+    }
+  }
 
-  // Initialize OLED
+  // Initialize the OLED once Vext has settled
+  while (millis() - vextOnMs < OLED_POWER_UP_MS) delay(1);
+  Wire.begin(OLED_SDA, OLED_SCL);
+  digitalWrite(OLED_RST, HIGH);
   if (!display.begin(SSD1306_SWITCHCAPVCC, SCREEN_ADDRESS)) {
     Serial.println("OLED display failed!");
     while (1) delay(1000);
   }
   Serial.println("OLED display initialized");
 
-  // Show startup screen
-  display.clearDisplay();
   display.setTextSize(1);
   display.setTextColor(SSD1306_WHITE);
-  display.setCursor(0, 0);
-  display.println("HOME UNIT");
-  display.println("LoRa Receiver");
-  display.println();
-  display.println("Initializing...");
-  display.display();
-
-  // Initialize LoRa
-  loraInitialized = initLoRa();
 
   if (!loraInitialized) {
     display.clearDisplay();
@@ -135,15 +181,22 @@ void setup() {
     while (1) delay(1000);
   }
 
-  // Set up interrupt-driven receive
-  radio.setDio1Action(setFlag);
+  #if BOOT_SPLASH
+    // Show startup screen
+    display.clearDisplay();
+    display.setCursor(0, 0);
+    display.println("HOME UNIT");
+    display.println("LoRa Receiver");
+    display.println();
+    display.println("Initializing...");
+    display.display();
+    delay(BOOT_SPLASH_MS);
+  #endif
 
-  // Start listening
-  int state = radio.startReceive();
-  if (state != RADIOLIB_ERR_NONE) {
-    Serial.print("startReceive failed: ");
-    Serial.println(state);
-  }
+  setupDoneMs = millis();
+  Serial.print("Setup done in ");
+  Serial.print(setupDoneMs);
+  Serial.println(" ms");
 
   Serial.println();
   Serial.println("Listening for packets...");
@@ -179,6 +232,19 @@ bool initLoRa() {
     return false;
   }
 
+  // Implicit header: length, coding rate and CRC come from lora_config.h
+  #if LORA_IMPLICIT_HEADER
+    state = radio.implicitHeader(LORA_IMPLICIT_LEN);
+    if (state == RADIOLIB_ERR_NONE) {
+      state = radio.setCRC(LORA_CRC_BYTES);
+    }
+    if (state != RADIOLIB_ERR_NONE) {
+      Serial.print("FAILED! Implicit header error: ");
+      Serial.println(state);
+      return false;
+    }
+  #endif
+
   Serial.println("OK");
   Serial.print("  Frequency: ");
   Serial.print(LORA_FREQUENCY);
@@ -199,12 +265,16 @@ void loop() {
     radio.startReceive();
   }
 
+  serviceSerialCommands();
+
   // Check connection status
   unsigned long now = millis();
   if (lastPacketTime > 0 && (now - lastPacketTime) > RX_TIMEOUT_MS) {
     if (connectionActive) {
       connectionActive = false;
-      Serial.println("CONNECTION LOST - No data for 60 seconds");
+      Serial.print("CONNECTION LOST - No data for ");
+      Serial.print(RX_TIMEOUT_MS / 1000);
+      Serial.println(" seconds");
       updateDisplay();
     }
   }
@@ -214,8 +284,10 @@ void loop() {
 }
 
 void processPacket() {
-  SensorPacket pkt;
-  int state = radio.readData((uint8_t*)&pkt, sizeof(SensorPacket));
+  RxFrame rx;
+  SensorPacket& pkt = rx.sensor;
+  size_t rxLen = radio.getPacketLength();
+  int state = radio.readData(rx.bytes, sizeof(rx.bytes));
 
   if (state != RADIOLIB_ERR_NONE) {
     Serial.print("Read error: ");
@@ -228,13 +300,32 @@ void processPacket() {
   int rssi = radio.getRSSI();
   float snr = radio.getSNR();
 
-  // Validate checksum
-  if (!validateChecksum(&pkt)) {
+  // Batched readings are expanded into one reading each
+  if (isBatchFrame(rx.bytes, rxLen)) {
+    processBatchPacket(rx.bytes, rxLen, rssi, snr);
+    return;
+  }
+
+  // Validate checksum (compact frames are expanded into pkt)
+  bool compact;
+  if (!unpackFrame(&pkt, rxLen, &compact)) {
     Serial.println("Checksum error - packet discarded");
     packetErrors++;
     return;
   }
 
+  // Per-channel currents arrive in their own packet after the sensor packet
+  if (pkt.msgType == MSG_TYPE_CHANNELS) {
+    processChannelPacket(rx.bytes, rxLen);
+    return;
+  }
+
+  // Storm burst summary (river unit storm mode)
+  if (pkt.msgType == MSG_TYPE_STORM) {
+    processStormPacket(rx.bytes, rxLen);
+    return;
+  }
+
   // Accept both direct (MSG_TYPE_SENSOR) and relayed (MSG_TYPE_RELAY) packets
   if (pkt.msgType != MSG_TYPE_SENSOR && pkt.msgType != MSG_TYPE_RELAY) {
     Serial.print("Unknown message type: ");
@@ -242,52 +333,283 @@ void processPacket() {
     return;
   }
 
-  // Check source
-  if (pkt.sourceId != UNIT_ID_RIVER) {
-    Serial.print("Unknown source: ");
-    Serial.println(pkt.sourceId);
+  NodeEntry* node = sourceNode(pkt.sourceId);
+  if (!node) return;
+
+  // Both relays forward the same packet - the reading is counted and
+  // filtered once, a repeat copy only updates the link it came over
+  if (!trackSequence(node, pkt.sequence)) {
+    processDuplicate(node, &pkt, rssi, snr);
     return;
   }
+  processReading(node, &pkt, rssi, snr);
+}
 
-  // Valid packet received!
+// Table entry for a packet's source, added on first contact; nullptr if it
+// isn't a sensor node or the table is full
+NodeEntry* sourceNode(uint8_t sourceId) {
+  if (!isSensorSource(sourceId)) {
+    Serial.print("Unknown source: ");
+    Serial.println(sourceId);
+    return nullptr;
+  }
+
+  bool added;
+  NodeEntry* node = nodeLookup(&nodes, sourceId, &added, DISPLAY_FILTER_SHIFT);
+  if (!node) {
+    Serial.print("Node table full - ignoring node ");
+    Serial.println(sourceId);
+  } else if (added) {
+    Serial.print("New node ");
+    Serial.print(sourceId);
+    Serial.print(" (");
+    Serial.print(nodes.count);
+    Serial.println(" in table)");
+  }
+  return node;
+}
+
+// Count a sensor or batch packet; false if it repeats the node's last one
+bool trackSequence(NodeEntry* node, uint8_t sequence) {
+  uint8_t missed;
+  bool isNew = nodeTrackSequence(node, sequence, &missed);
+  if (missed > 0) {
+    Serial.print("Node ");
+    Serial.print(node->id);
+    Serial.print(": missed ");
+    Serial.print(missed);
+    Serial.println(" packet(s)");
+  }
+  return isNew;
+}
+
+// One valid sensor reading, direct or relayed
+void processReading(NodeEntry* node, SensorPacket* pkt, int rssi, float snr) {
+  storeReading(node, pkt, rssi, snr);
+
+  // Print to serial
+  printSerialData(pkt, rssi, snr);
+
+  // Update display
+  updateDisplay();
+}
+
+// Count a reading and fold it into the node's state and display filter
+void storeReading(NodeEntry* node, SensorPacket* pkt, int rssi, float snr) {
   packetsReceived++;
   lastPacketTime = millis();
   connectionActive = true;
 
-  // Check for missed packets
-  uint8_t expectedSeq = lastSequence + 1;
-  if (packetsReceived > 1 && pkt.sequence != expectedSeq) {
-    int missed = (pkt.sequence - expectedSeq + 256) % 256;
-    if (missed > 0 && missed < 128) {  // Forward gap
-      Serial.print("Missed ");
-      Serial.print(missed);
-      Serial.println(" packet(s)");
-    }
+  if (packetsReceived == 1) {
+    Serial.print("Boot to first packet: ");
+    Serial.print(lastPacketTime);
+    Serial.print(" ms (setup ");
+    Serial.print(setupDoneMs);
+    Serial.println(" ms)");
   }
-  lastSequence = pkt.sequence;
 
   // Store data
-  lastCurrent = pkt.current_mA;
-  lastMoisture = pkt.moisturePercent;
-  lastRSSI_River = pkt.rssi;  // RSSI at ridge (from river)
-  lastRSSI_Home = rssi;        // RSSI here (from ridge)
-  lastSNR = snr;
-  lastBattery = pkt.batteryPercent;
+  node->lastMs = lastPacketTime;
+  node->current_mA = pkt->current_mA;
+  node->moisture_dPct = pkt->moisture_dPct;
+  node->faultFlags = pkt->faultFlags;
+  node->batteryPercent = pkt->batteryPercent;
+  node->relayId = pkt->relayId;
+  node->rssiRelay = pkt->rssi;  // RSSI at ridge (from the node)
+  node->rssiHome = rssi;        // RSSI here (last hop)
+  node->snr = snr;
+
+  // Smooth the displayed level; restart the filter if the loop drops out.
+  // A flagged jump is held back from the filter but still shown in the log.
+  if (pkt->faultFlags & DIAG_CURRENT_JUMP) {
+    // Keep the previous displayed level
+  } else if (pkt->current_mA >= MIN_CURRENT_MA) {
+    node->displayCurrent = filterUpdate(&node->filter, lroundf(pkt->current_mA * 1000.0)) / 1000.0;
+  } else {
+    filterInit(&node->filter, DISPLAY_FILTER_SHIFT);
+    node->displayCurrent = pkt->current_mA;
+  }
+  displayNode = node;
+}
 
-  // Print to serial
-  printSerialData(&pkt, rssi, snr);
+// Repeat copy of a node's last packet (the other relay): refresh the path
+// and RSSI shown for it, leave the counters and the display filter alone
+void processDuplicate(NodeEntry* node, SensorPacket* pkt, int rssi, float snr) {
+  lastPacketTime = millis();
+  connectionActive = true;
 
-  // Update display
+  node->relayId = pkt->relayId;
+  node->rssiRelay = pkt->rssi;
+  node->rssiHome = rssi;
+  node->snr = snr;
+
+  Serial.print("Node ");
+  Serial.print(pkt->sourceId);
+  Serial.print(", packet #");
+  Serial.print(pkt->sequence);
+  Serial.print(" again via ");
+  Serial.print(pkt->relayId == UNIT_ID_RIDGE ? "Ridge Relay (Primary/Heltec)" :
+               pkt->relayId == UNIT_ID_RIDGE2 ? "Ridge Relay (Secondary/T-Deck)" : "Direct");
+  Serial.print(", RSSI ");
+  Serial.print(rssi);
+  Serial.print(" dBm, SNR ");
+  Serial.print(snr);
+  Serial.println(" dB");
+
+  if (node == displayNode) updateDisplay();
+}
+
+void processBatchPacket(const uint8_t* frame, size_t len, int rssi, float snr) {
+  SensorBatch batch;
+  if (!decodeBatchFrame(&batch, frame, len)) {
+    Serial.println("Batch CRC error - packet discarded");
+    packetErrors++;
+    return;
+  }
+
+  NodeEntry* node = sourceNode(batch.sourceId);
+  if (!node) return;
+
+  // Both relays forward the same batch - unpack it once
+  if (!trackSequence(node, batch.sequence)) return;
+
+  // Same stream as single packets; faults and battery are the node's state
+  // when it sent the batch, so they belong to the newest reading. A jump flag
+  // on the batch doesn't apply to the older readings and must not keep them
+  // out of the display filter. Each reading updates the node and filter; the
+  // newest gets the full printout and the display is redrawn once.
+  SensorPacket pkt;
+  for (uint8_t i = 0; i < batch.count; i++) {
+    const BatchReading* r = &batch.readings[i];
+    bool newest = i == batch.count - 1;
+
+    memset(&pkt, 0, sizeof(SensorPacket));
+    pkt.msgType = batch.relayId ? MSG_TYPE_RELAY : MSG_TYPE_SENSOR;
+    pkt.sourceId = batch.sourceId;
+    pkt.relayId = batch.relayId;
+    pkt.sequence = batch.sequence;
+    pkt.current_mA = r->current_cmA / 100.0;
+    pkt.moisture_dPct = r->moisture * 5;
+    pkt.faultFlags = newest ? batch.faultFlags : batch.faultFlags & ~DIAG_CURRENT_JUMP;
+    pkt.rssi = batch.rssi;
+    pkt.batteryPercent = batch.batteryPercent;
+    pkt.checksum = calculateChecksum(&pkt);
+
+    Serial.print("Batch #");
+    Serial.print(batch.sequence);
+    Serial.print(" reading ");
+    Serial.print(i + 1);
+    Serial.print("/");
+    Serial.print(batch.count);
+    Serial.print(", taken ");
+    Serial.print(r->age_s);
+    Serial.print(" s before sending");
+    Serial.print(r->flags & BATCH_READING_RAIN ? " (rain onset)" : "");
+    if (!newest) {
+      Serial.print(": ");
+      Serial.print(pkt.current_mA, 2);
+      Serial.print(" mA, moisture ");
+      Serial.print(pkt.moisture_dPct / 10.0, 1);
+      Serial.print("%");
+    }
+    Serial.println();
+    storeReading(node, &pkt, rssi, snr);
+  }
+
+  printSerialData(&pkt, rssi, snr);
   updateDisplay();
 }
 
+void processChannelPacket(uint8_t* frame, size_t len) {
+  const ChannelPacket* pkt = packetDecode<ChannelPacket>(frame, len);
+  if (!pkt || pkt->channelCount == 0 || pkt->channelCount > MAX_CURRENT_CHANNELS) {
+    Serial.println("Invalid channel packet - discarded");
+    return;
+  }
+
+  NodeEntry* node = sourceNode(pkt->sourceId);
+  if (!node) return;
+
+  // Both relays forward the same packet - print it once
+  if (!nodeFollowUpIsNew(node, NODE_SEEN_CHANNELS, &node->channelSequence, pkt->sequence)) return;
+
+  node->channelCount = pkt->channelCount;
+
+  Serial.print("--- Node ");
+  Serial.print(node->id);
+  Serial.print(" Channels (packet #");
+  Serial.print(pkt->sequence);
+  Serial.println(") ---");
+  for (uint8_t i = 0; i < pkt->channelCount; i++) {
+    node->channel_cmA[i] = pkt->current_cmA[i];
+    float current = pkt->current_cmA[i] / 100.0;
+
+    Serial.print("Ch");
+    Serial.print(i);
+    Serial.print(": ");
+    Serial.print(current, 2);
+    Serial.print(" mA");
+    if (current >= MIN_CURRENT_MA) {
+      Serial.print(", Depth: ");
+      Serial.print(calculateDepth(current) * CM_TO_INCHES, 1);
+      Serial.print(" in");
+    }
+    Serial.println();
+  }
+  Serial.println();
+}
+
+void processStormPacket(uint8_t* frame, size_t len) {
+  const StormPacket* pkt = packetDecode<StormPacket>(frame, len);
+  if (!pkt) {
+    Serial.println("Invalid storm packet - discarded");
+    return;
+  }
+
+  NodeEntry* node = sourceNode(pkt->sourceId);
+  if (!node) return;
+
+  // Both relays forward the same packet - print it once
+  if (!nodeFollowUpIsNew(node, NODE_SEEN_STORM, &node->stormSequence, pkt->sequence)) return;
+
+  float mean = pkt->mean_cmA / 100.0;
+
+  Serial.print("--- Node ");
+  Serial.print(node->id);
+  Serial.print(" Storm Burst (packet #");
+  Serial.print(pkt->sequence);
+  Serial.println(") ---");
+  Serial.print("Current: mean ");
+  Serial.print(mean, 2);
+  Serial.print(" mA, SD ");
+  Serial.print(pkt->sd_cmA / 100.0, 2);
+  Serial.print(" mA, range ");
+  Serial.print(mean - pkt->minBelow_5cmA / 20.0, 2);
+  Serial.print("-");
+  Serial.print(mean + pkt->maxAbove_5cmA / 20.0, 2);
+  Serial.println(" mA");
+  for (uint8_t b = 0; b < STORM_BANDS; b++) {
+    Serial.print(STORM_BAND_NAMES[b]);
+    Serial.print(" (");
+    Serial.print(STORM_BAND_EDGES_DHZ[b] / 10.0, 1);
+    Serial.print("-");
+    Serial.print(STORM_BAND_EDGES_DHZ[b + 1] / 10.0, 1);
+    Serial.print(" Hz): ");
+    Serial.print(pkt->bandDb[b]);
+    Serial.println(" dB re 1 uA^2");
+  }
+  Serial.println();
+}
+
 void printSerialData(SensorPacket* pkt, int rssi, float snr) {
   float depthCm = calculateDepth(pkt->current_mA);
   float depthInches = depthCm * CM_TO_INCHES;
   float depthPercent = calculatePercentage(pkt->current_mA);
 
   Serial.println("========== RIVER DATA RECEIVED ==========");
-  Serial.print("Packet #");
+  Serial.print("Node ");
+  Serial.print(pkt->sourceId);
+  Serial.print(", packet #");
   Serial.print(pkt->sequence);
   Serial.print(" (");
   Serial.print(packetsReceived);
@@ -335,34 +657,134 @@ void printSerialData(SensorPacket* pkt, int rssi, float snr) {
     Serial.print(" (");
     Serial.print(depthPercent, 1);
     Serial.println("%)");
+    printDerived(pkt->current_mA);
   } else {
     Serial.println("Depth: N/A (INA219 not connected)");
   }
 
   Serial.print("Moisture: ");
-  Serial.print(pkt->moisturePercent, 1);
+  Serial.print(pkt->moisture_dPct / 10.0, 1);
   Serial.println("%");
 
   Serial.print("River Battery: ");
   Serial.print(pkt->batteryPercent);
   Serial.println("%");
 
+  if (pkt->faultFlags) {
+    Serial.print("SENSOR FAULTS:");
+    for (uint8_t i = 0; i < DIAG_FAULT_COUNT; i++) {
+      if (pkt->faultFlags & (1 << i)) {
+        Serial.print(" [");
+        Serial.print(DIAG_FAULT_NAMES[i]);
+        Serial.print("]");
+      }
+    }
+    Serial.println();
+  }
+
   Serial.println("=========================================");
   Serial.println();
 }
 
 float calculateDepth(float current_mA) {
   if (current_mA < MIN_CURRENT_MA) return 0;
-  current_mA = constrain(current_mA, MIN_CURRENT_MA, MAX_CURRENT_MA);
-  float depth = ((current_mA - MIN_CURRENT_MA) / (MAX_CURRENT_MA - MIN_CURRENT_MA)) * MAX_DEPTH_CM;
-  return depth;
+  return calDepthMm(depthCal, lroundf(current_mA * 1000.0)) / 10.0;
 }
 
 float calculatePercentage(float current_mA) {
-  if (current_mA < MIN_CURRENT_MA) return 0;
-  current_mA = constrain(current_mA, MIN_CURRENT_MA, MAX_CURRENT_MA);
-  float percentage = ((current_mA - MIN_CURRENT_MA) / (MAX_CURRENT_MA - MIN_CURRENT_MA)) * 100.0;
-  return percentage;
+  return calculateDepth(current_mA) * 1000.0 / calFullScaleMm(depthCal);
+}
+
+// Discharge or stored volume for the reading (DERIVED_QUANTITY)
+void printDerived(float current_mA) {
+  int32_t depthMm = calDepthMm(depthCal, lroundf(current_mA * 1000.0));
+
+  #if DERIVED_QUANTITY == DERIVED_FLOW
+    Serial.print("Flow: ");
+    Serial.print(ratingDischargeCfs(depthMm), 2);
+    Serial.println(" cfs");
+  #elif DERIVED_QUANTITY == DERIVED_VOLUME
+    Serial.print("Volume: ");
+    Serial.print(tankVolumeLitres(depthMm) * LITRES_TO_GALLONS, 0);
+    Serial.print(" gal (");
+    Serial.print(tankFillPercent(depthMm), 1);
+    Serial.println("% full)");
+  #else
+    (void)depthMm;
+  #endif
+}
+
+// Read serial commands without blocking (one line at a time)
+void serviceSerialCommands() {
+  static char line[48];
+  static uint8_t len = 0;
+
+  while (Serial.available()) {
+    char c = Serial.read();
+    if (c == '\r' || c == '\n') {
+      if (len == 0) continue;
+      line[len] = '\0';
+      len = 0;
+      if (strcmp(line, "NODES") == 0) {
+        printNodeTable();
+      } else if (!calHandleCommand(&depthCal, line, -1)) {
+        Serial.print("Unknown command: ");
+        Serial.println(line);
+      }
+    } else if (len < sizeof(line) - 1) {
+      line[len++] = toupper(c);
+    }
+  }
+}
+
+// Every node heard, with its last values and link stats ("NODES")
+void printNodeTable() {
+  unsigned long now = millis();
+
+  Serial.print("--- Nodes (");
+  Serial.print(nodes.count);
+  Serial.print(" of ");
+  Serial.print(NODE_TABLE_SIZE);
+  Serial.println(") ---");
+  for (uint16_t i = 0; i < NODE_TABLE_SIZE; i++) {
+    const NodeEntry* n = &nodes.slots[i];
+    if (n->id == NODE_ID_EMPTY) continue;
+
+    Serial.print("Node ");
+    Serial.print(n->id);
+    Serial.print(": ");
+    Serial.print(n->current_mA, 2);
+    Serial.print(" mA, ");
+    Serial.print(n->moisture_dPct / 10.0, 1);
+    Serial.print("%, bat ");
+    Serial.print(n->batteryPercent);
+    Serial.print("%, RX ");
+    Serial.print(n->packets);
+    Serial.print(" missed ");
+    Serial.print(n->missed);
+    Serial.print(" dup ");
+    Serial.print(n->duplicates);
+    if (n->relayId != 0) {
+      Serial.print(", via ");
+      Serial.print(n->relayId);
+      Serial.print(" ");
+      Serial.print(n->rssiRelay);
+      Serial.print("/");
+    } else {
+      Serial.print(", direct ");
+    }
+    Serial.print(n->rssiHome);
+    Serial.print(" dBm SNR ");
+    Serial.print(n->snr, 1);
+    Serial.print(", ");
+    Serial.print((now - n->lastMs) / 1000);
+    Serial.print(" s ago");
+    if (n->faultFlags) {
+      Serial.print(" FAULT");
+    }
+    Serial.println();
+  }
+  Serial.println();
 }
 
 void updateDisplay() {
@@ -380,22 +802,38 @@ void updateDisplay() {
   } else {
     display.print("WAITING...");
   }
+  if (displayNode && nodes.count > 1) {
+    display.print(" #");
+    display.print(displayNode->id);
+  }
   display.drawLine(0, 10, SCREEN_WIDTH, 10, SSD1306_WHITE);
 
-  if (packetsReceived > 0) {
+  if (displayNode) {
     // Calculate depth for display
-    float depthCm = calculateDepth(lastCurrent);
+    float displayCurrent = displayNode->displayCurrent;
+    float moisture = displayNode->moisture_dPct / 10.0;
+    float depthCm = calculateDepth(displayCurrent);
     float depthInches = depthCm * CM_TO_INCHES;
-    float depthPercent = calculatePercentage(lastCurrent);
+    float depthPercent = calculatePercentage(displayCurrent);
 
     // Water level display
-    if (lastCurrent >= MIN_CURRENT_MA) {
+    if (displayCurrent >= MIN_CURRENT_MA) {
       display.setCursor(0, 14);
-      display.print("Level:");
-      display.print(depthPercent, 0);
-      display.print("% ");
+      #if DERIVED_QUANTITY == DERIVED_FLOW
+        display.print("Q:");
+        display.print(ratingDischargeCfs(lroundf(depthCm * 10.0)), 1);
+        display.print("cfs ");
+      #elif DERIVED_QUANTITY == DERIVED_VOLUME
+        display.print("V:");
+        display.print(tankVolumeLitres(lroundf(depthCm * 10.0)) * LITRES_TO_GALLONS, 0);
+        display.print("gal ");
+      #else
+        display.print("Level:");
+        display.print(depthPercent, 0);
+        display.print("% ");
+      #endif
       display.print("M:");
-      display.print(lastMoisture, 0);
+      display.print(moisture, 0);
       display.print("%");
 
       // Large depth display
@@ -420,7 +858,7 @@ void updateDisplay() {
 
       display.setTextSize(2);
       display.setCursor(0, 28);
-      display.print(lastMoisture, 1);
+      display.print(moisture, 1);
       display.print("%");
     }
 
@@ -428,9 +866,9 @@ void updateDisplay() {
     display.setTextSize(1);
     display.setCursor(0, 48);
     display.print("Riv:");
-    display.print(lastRSSI_River);
+    display.print(displayNode->rssiRelay);
     display.print(" Hm:");
-    display.print(lastRSSI_Home);
+    display.print(displayNode->rssiHome);
     display.print("dBm");
 
     display.setCursor(0, 56);
@@ -440,6 +878,9 @@ void updateDisplay() {
       display.print(" Err:");
       display.print(packetErrors);
     }
+    if (displayNode->faultFlags) {
+      display.print(" FAULT");
+    }
   } else {
     // No data yet
     display.setCursor(0, 20);
@@ -0,0 +1,151 @@
+/*
+ * Node Table - Per-source state for a network of sensor nodes
+ *
+ * Used by the home unit. The copy in home_unit/ must match this file.
+ *
+ * One entry per sensor node, keyed by the sourceId its packets carry, in a
+ * fixed array of NODE_TABLE_SIZE slots (a power of two) - nothing is
+ * allocated at run time. Lookup is open addressing with linear probing from
+ * slot (id & (NODE_TABLE_SIZE - 1)): IDs handed out in order each land in
+ * their own slot, so the RX path finds its entry in one probe. Entries are
+ * never removed; a node that goes quiet keeps its last values and its age
+ * shows how stale they are.
+ *
+ * Each entry holds:
+ *   - sequence tracking: packets, packets missed (forward gaps) and
+ *     duplicate copies (the same packet via both relays)
+ *   - the last reading's values, plus the display filter for its current
+ *   - the last reading's link: relay, RSSI at the relay and here, SNR
+ *   - the sequences of the follow-up packets already handled (channels,
+ *     storm summary), so each is processed once per node
+ */
+
+#ifndef NODE_TABLE_H
+#define NODE_TABLE_H
+
+#include <stdint.h>
+#include <string.h>
+#include "lora_config.h"
+#include "sensor_filter.h"
+
+#define NODE_TABLE_SIZE         64       // Slots, power of two
+#define NODE_ID_EMPTY           0        // sourceId 0 is never sent
+
+// NodeEntry.followSeen: a follow-up packet of this type has been handled
+#define NODE_SEEN_CHANNELS      0x01
+#define NODE_SEEN_STORM         0x02
+
+static_assert((NODE_TABLE_SIZE & (NODE_TABLE_SIZE - 1)) == 0, "NODE_TABLE_SIZE must be a power of two");
+static_assert(NODE_TABLE_SIZE <= 256, "Node IDs are 8 bits");
+
+typedef struct {
+  uint8_t  id;              // sourceId, NODE_ID_EMPTY if the slot is free
+
+  // Sequence tracking
+  uint8_t  lastSequence;
+  uint32_t packets;         // Sensor and batch packets accepted
+  uint32_t missed;          // Packets lost (forward sequence gaps)
+  uint32_t duplicates;      // Repeat copies of the last packet
+  uint32_t lastMs;          // millis() at the last reading
+
+  // Last reading
+  float    current_mA;
+  float    displayCurrent;  // Filtered current for the display
+  SensorFilter filter;      // Filters current in microamps
+  uint16_t moisture_dPct;   // 0.1 %
+  uint16_t faultFlags;      // DIAG_* bits
+  uint8_t  batteryPercent;
+
+  // Link of the last reading
+  uint8_t  relayId;         // 0 if direct
+  int16_t  rssiRelay;       // At the relay (sensor->relay), dBm
+  int16_t  rssiHome;        // Here (last hop), dBm
+  float    snr;             // Here, dB
+
+  // Follow-up packets
+  uint8_t  followSeen;      // NODE_SEEN_* bits
+  uint8_t  channelSequence;
+  uint8_t  stormSequence;
+  uint8_t  channelCount;
+  uint16_t channel_cmA[MAX_CURRENT_CHANNELS];   // 0.01 mA
+} NodeEntry;
+
+typedef struct {
+  NodeEntry slots[NODE_TABLE_SIZE];
+  uint16_t  count;          // Slots in use (up to NODE_TABLE_SIZE)
+} NodeTable;
+
+inline void nodeTableInit(NodeTable* t) {
+  memset(t, 0, sizeof(NodeTable));
+}
+
+inline uint8_t nodeSlot(uint8_t id) {
+  return id & (NODE_TABLE_SIZE - 1);
+}
+
+// Entry for a node, or nullptr if it hasn't been heard
+inline NodeEntry* nodeFind(NodeTable* t, uint8_t id) {
+  if (id == NODE_ID_EMPTY) return nullptr;
+  uint8_t slot = nodeSlot(id);
+  for (uint16_t probe = 0; probe < NODE_TABLE_SIZE; probe++) {
+    NodeEntry* n = &t->slots[slot];
+    if (n->id == id) return n;
+    if (n->id == NODE_ID_EMPTY) return nullptr;
+    slot = (slot + 1) & (NODE_TABLE_SIZE - 1);
+  }
+  return nullptr;
+}
+
+// Entry for a node, added on first contact (added is set). Returns nullptr
+// if the table is full.
+inline NodeEntry* nodeLookup(NodeTable* t, uint8_t id, bool* added, uint8_t filterShift) {
+  *added = false;
+  if (id == NODE_ID_EMPTY) return nullptr;
+  uint8_t slot = nodeSlot(id);
+  for (uint16_t probe = 0; probe < NODE_TABLE_SIZE; probe++) {
+    NodeEntry* n = &t->slots[slot];
+    if (n->id == id) return n;
+    if (n->id == NODE_ID_EMPTY) {
+      memset(n, 0, sizeof(NodeEntry));
+      n->id = id;
+      filterInit(&n->filter, filterShift);
+      t->count++;
+      *added = true;
+      return n;
+    }
+    slot = (slot + 1) & (NODE_TABLE_SIZE - 1);
+  }
+  return nullptr;
+}
+
+// Count a sensor or batch packet's sequence number (one stream per node).
+// missed is set to the packets lost before it; returns false for a repeat
+// copy of the last packet.
+inline bool nodeTrackSequence(NodeEntry* n, uint8_t sequence, uint8_t* missed) {
+  *missed = 0;
+  if (n->packets > 0) {
+    uint8_t gap = sequence - (uint8_t)(n->lastSequence + 1);
+    if (sequence == n->lastSequence) {
+      n->duplicates++;
+      return false;
+    }
+    if (gap < 128) {
+      *missed = gap;
+      n->missed += gap;
+    }
+  }
+  n->packets++;
+  n->lastSequence = sequence;
+  return true;
+}
+
+// True the first time a follow-up packet (NODE_SEEN_*) with this sequence
+// arrives from the node; later copies return false
+inline bool nodeFollowUpIsNew(NodeEntry* n, uint8_t seenBit, uint8_t* lastSequence, uint8_t sequence) {
+  if ((n->followSeen & seenBit) && *lastSequence == sequence) return false;
+  n->followSeen |= seenBit;
+  *lastSequence = sequence;
+  return true;
+}
+
+#endif // NODE_TABLE_H
@@ -0,0 +1,255 @@
+/*
+ * Depth Calibration - Piecewise-linear loop current to depth conversion
+ *
+ * Shared by every unit that shows depth. The copies in river_unit/,
+ * home_unit/ and ridge_relay/ must match this file (tdeck_relay includes
+ * it from the parent directory).
+ *
+ * The table maps loop current (microamps) to depth (millimetres) with up
+ * to CAL_MAX_POINTS points. Lookups are integer-only linear interpolation
+ * between the two surrounding points and clamp outside the table.
+ *
+ * The default table is the sensor's nominal linear 4-20 mA span and is
+ * checked at compile time. A measured table can be captured over serial
+ * with the CAL commands below and saved to NVS, where calLoad() finds it
+ * at boot.
+ *
+ * Serial commands (calHandleCommand):
+ *   CAL                  List the active table
+ *   CAL ADD <cm>         Add a point at the live sensor current (river unit)
+ *   CAL ADD <mA> <cm>    Add a point at an explicit current
+ *   CAL SAVE             Store the active table in NVS
+ *   CAL RESET            Return to the default table and erase NVS copy
+ */
+
+#ifndef DEPTH_CALIBRATION_H
+#define DEPTH_CALIBRATION_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <Preferences.h>
+
+#define CAL_MAX_POINTS          8
+
+// Default (uncalibrated) span - adjust to match your sensor and tank
+#define CAL_DEFAULT_EMPTY_UA    4000     // 4 mA  = 0 depth
+#define CAL_DEFAULT_FULL_UA     20000    // 20 mA = full depth
+#define CAL_DEFAULT_FULL_MM     1000     // 100 cm full-scale depth
+
+#define CAL_NVS_NAMESPACE       "depthcal"
+#define CAL_NVS_KEY             "table"
+
+typedef struct {
+  int32_t current_uA;   // Loop current at this point
+  int32_t depth_mm;     // Water depth at this point
+} CalPoint;
+
+typedef struct {
+  uint8_t  count;                    // Points in use (2..CAL_MAX_POINTS)
+  CalPoint points[CAL_MAX_POINTS];   // Sorted by strictly increasing current
+} CalTable;
+
+constexpr CalTable CAL_DEFAULT_TABLE = {
+  2,
+  { { CAL_DEFAULT_EMPTY_UA, 0 }, { CAL_DEFAULT_FULL_UA, CAL_DEFAULT_FULL_MM } }
+};
+
+// A table is usable if it has 2+ points with strictly increasing current
+constexpr bool calValid(const CalTable& t) {
+  if (t.count < 2 || t.count > CAL_MAX_POINTS) return false;
+  for (uint8_t i = 1; i < t.count; i++) {
+    if (t.points[i].current_uA <= t.points[i - 1].current_uA) return false;
+  }
+  return true;
+}
+
+static_assert(calValid(CAL_DEFAULT_TABLE), "Default calibration table is invalid");
+
+// Depth (mm) for a loop current (uA), clamped to the table ends
+constexpr int32_t calDepthMm(const CalTable& t, int32_t current_uA) {
+  if (current_uA <= t.points[0].current_uA) return t.points[0].depth_mm;
+
+  for (uint8_t i = 1; i < t.count; i++) {
+    const CalPoint& hi = t.points[i];
+    if (current_uA <= hi.current_uA) {
+      const CalPoint& lo = t.points[i - 1];
+      return lo.depth_mm + (int32_t)((int64_t)(current_uA - lo.current_uA) *
+                                     (hi.depth_mm - lo.depth_mm) /
+                                     (hi.current_uA - lo.current_uA));
+    }
+  }
+
+  return t.points[t.count - 1].depth_mm;
+}
+
+// Full-scale depth (mm) - depth at the highest calibrated current
+constexpr int32_t calFullScaleMm(const CalTable& t) {
+  return t.points[t.count - 1].depth_mm;
+}
+
+static_assert(calDepthMm(CAL_DEFAULT_TABLE, 12000) == CAL_DEFAULT_FULL_MM / 2,
+              "Default calibration midpoint is off");
+
+// Insert a point in current order, replacing one at the same current
+inline bool calAddPoint(CalTable* t, int32_t current_uA, int32_t depth_mm) {
+  uint8_t i = 0;
+  while (i < t->count && t->points[i].current_uA < current_uA) i++;
+
+  if (i < t->count && t->points[i].current_uA == current_uA) {
+    t->points[i].depth_mm = depth_mm;
+    return true;
+  }
+  if (t->count >= CAL_MAX_POINTS) return false;
+
+  for (uint8_t j = t->count; j > i; j--) {
+    t->points[j] = t->points[j - 1];
+  }
+  t->points[i].current_uA = current_uA;
+  t->points[i].depth_mm = depth_mm;
+  t->count++;
+  return true;
+}
+
+// Load the saved table from NVS, or the default if none/invalid
+inline bool calLoad(CalTable* t) {
+  Preferences prefs;
+  CalTable stored;
+  bool ok = false;
+
+  if (prefs.begin(CAL_NVS_NAMESPACE, true)) {
+    ok = prefs.getBytes(CAL_NVS_KEY, &stored, sizeof(CalTable)) == sizeof(CalTable) &&
+         calValid(stored);
+    prefs.end();
+  }
+
+  *t = ok ? stored : CAL_DEFAULT_TABLE;
+  return ok;
+}
+
+inline bool calSave(const CalTable* t) {
+  if (!calValid(*t)) return false;
+
+  Preferences prefs;
+  if (!prefs.begin(CAL_NVS_NAMESPACE, false)) return false;
+  bool ok = prefs.putBytes(CAL_NVS_KEY, t, sizeof(CalTable)) == sizeof(CalTable);
+  prefs.end();
+  return ok;
+}
+
+inline void calErase() {
+  Preferences prefs;
+  if (prefs.begin(CAL_NVS_NAMESPACE, false)) {
+    prefs.remove(CAL_NVS_KEY);
+    prefs.end();
+  }
+}
+
+inline void calPrint(const CalTable* t) {
+  Serial.print("Depth calibration (");
+  Serial.print(t->count);
+  Serial.println(" points):");
+  for (uint8_t i = 0; i < t->count; i++) {
+    Serial.print("  ");
+    Serial.print(i);
+    Serial.print(": ");
+    Serial.print(t->points[i].current_uA / 1000.0, 3);
+    Serial.print(" mA -> ");
+    Serial.print(t->points[i].depth_mm / 10.0, 1);
+    Serial.println(" cm");
+  }
+}
+
+// Handle a "CAL ..." serial command line. liveCurrent_uA is the unit's own
+// sensor reading, or a negative value on units without a sensor.
+// Returns false if the line is not a CAL command.
+//
+// Points are edited in a working copy; the active table only changes once
+// the working copy holds a valid table, so a half-entered calibration never
+// disturbs readings.
+inline bool calHandleCommand(CalTable* active, const char* line, int32_t liveCurrent_uA) {
+  static CalTable working = CAL_DEFAULT_TABLE;
+  static bool editing = false;
+
+  if (strncmp(line, "CAL", 3) != 0) return false;
+  const char* args = line + 3;
+  while (*args == ' ') args++;
+
+  if (*args == '\0') {
+    calPrint(active);
+    if (editing && !calValid(working)) {
+      Serial.print("  (capture in progress: ");
+      Serial.print(working.count);
+      Serial.println(" point(s))");
+    }
+    return true;
+  }
+
+  if (strncmp(args, "ADD", 3) == 0) {
+    char* end;
+    float first = strtof(args + 3, &end);
+    if (end == args + 3) {
+      Serial.println("Usage: CAL ADD <cm> | CAL ADD <mA> <cm>");
+      return true;
+    }
+    char* end2;
+    float second = strtof(end, &end2);
+
+    int32_t current_uA;
+    int32_t depth_mm;
+    if (end2 != end) {
+      current_uA = lroundf(first * 1000.0f);
+      depth_mm = lroundf(second * 10.0f);
+    } else if (liveCurrent_uA >= 0) {
+      current_uA = liveCurrent_uA;
+      depth_mm = lroundf(first * 10.0f);
+    } else {
+      Serial.println("No live sensor - use CAL ADD <mA> <cm>");
+      return true;
+    }
+
+    // First ADD starts a fresh capture
+    if (!editing) {
+      working.count = 0;
+      editing = true;
+    }
+    if (!calAddPoint(&working, current_uA, depth_mm)) {
+      Serial.println("Calibration table full");
+      return true;
+    }
+
+    Serial.print("Added ");
+    Serial.print(current_uA / 1000.0, 3);
+    Serial.print(" mA -> ");
+    Serial.print(depth_mm / 10.0, 1);
+    Serial.println(" cm");
+
+    if (calValid(working)) *active = working;
+    calPrint(&working);
+    return true;
+  }
+
+  if (strncmp(args, "SAVE", 4) == 0) {
+    if (calSave(active)) {
+      Serial.println("Calibration saved to NVS");
+      editing = false;
+    } else {
+      Serial.println("Calibration save failed");
+    }
+    return true;
+  }
+
+  if (strncmp(args, "RESET", 5) == 0) {
+    *active = CAL_DEFAULT_TABLE;
+    editing = false;
+    calErase();
+    Serial.println("Calibration reset to default");
+    return true;
+  }
+
+  Serial.println("Unknown CAL command (CAL, CAL ADD, CAL SAVE, CAL RESET)");
+  return true;
+}
+
+#endif // DEPTH_CALIBRATION_H
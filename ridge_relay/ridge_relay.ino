@@ -28,6 +28,7 @@
 #include <Adafruit_SSD1306.h>
 #include <RadioLib.h>
 #include "lora_config.h"
+#include "depth_calibration.h"
 
 // ===== TEST MODE =====
 // Set to true to disable deep sleep and keep display on for testing
@@ -55,6 +56,9 @@ RTC_DATA_ATTR uint32_t lastRSSI = 0;
 RTC_DATA_ATTR float lastCurrent = 0;
 RTC_DATA_ATTR float lastMoisture = 0;
 
+// Depth calibration for the status display (default table or NVS copy)
+CalTable depthCal;
+
 // Create device instances
 Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RST);
 
@@ -75,6 +79,9 @@ void setRxFlag(void) {
 // Function declarations
 bool initLoRa();
 void goToDeepSleep();
+bool relayChannelPacket(uint8_t* frame, size_t len, int rxRSSI);
+bool relayStormPacket(uint8_t* frame, size_t len, int rxRSSI);
+bool relayBatchFrame(uint8_t* frame, size_t len, int rxRSSI);
 void updateDisplay(bool hasData, int rssi, float current, float moisture, uint32_t relayed);
 
 void setup() {
@@ -106,6 +113,8 @@ void setup() {
       break;
   }
 
+  calLoad(&depthCal);
+
   // Enable Vext power for OLED (required on some Heltec boards)
   pinMode(VEXT_CTRL, OUTPUT);
   digitalWrite(VEXT_CTRL, LOW);  // LOW = ON for Vext on Heltec V3
@@ -170,26 +179,53 @@ void setup() {
 
   // Listen for incoming packets
   unsigned long startTime = millis();
+  unsigned long listenWindow = RELAY_LISTEN_MS;
   bool receivedPacket = false;
 
-  while (millis() - startTime < RELAY_LISTEN_MS) {
+  while (millis() - startTime < listenWindow) {
     // Check for received packet
-    SensorPacket pkt;
-    int state = radio.receive((uint8_t*)&pkt, sizeof(SensorPacket));
+    RxFrame rx;
+    SensorPacket& pkt = rx.sensor;
+    int state = radio.receive(rx.bytes, sizeof(rx.bytes));
 
     if (state == RADIOLIB_ERR_NONE) {
       // Got a packet!
       Serial.println("Packet received!");
 
-      // Validate checksum
-      if (!validateChecksum(&pkt)) {
+      // Batched readings - a StormPacket or ChannelPacket may still follow
+      size_t rxLen = radio.getPacketLength();
+      if (isBatchFrame(rx.bytes, rxLen)) {
+        if (relayBatchFrame(rx.bytes, rxLen, radio.getRSSI())) receivedPacket = true;
+        startTime = millis();
+        listenWindow = RELAY_FOLLOW_MS;
+        continue;
+      }
+
+      // Validate checksum (compact frames are expanded into pkt)
+      bool compact;
+      if (!unpackFrame(&pkt, rxLen, &compact)) {
         Serial.println("  Checksum invalid - discarding");
         continue;
       }
 
+      // Per-channel currents from a multi-INA219 river unit - always the
+      // last packet of the river unit's cycle
+      if (pkt.msgType == MSG_TYPE_CHANNELS && isSensorSource(pkt.sourceId) && pkt.relayId == 0) {
+        if (relayChannelPacket(rx.bytes, rxLen, radio.getRSSI())) receivedPacket = true;
+        break;
+      }
+
+      // Storm burst summary - a ChannelPacket may still follow
+      if (pkt.msgType == MSG_TYPE_STORM && isSensorSource(pkt.sourceId) && pkt.relayId == 0) {
+        if (relayStormPacket(rx.bytes, rxLen, radio.getRSSI())) receivedPacket = true;
+        startTime = millis();
+        listenWindow = RELAY_FOLLOW_MS;
+        continue;
+      }
+
       // Check if this is a sensor packet from the river
-      if (pkt.msgType != MSG_TYPE_SENSOR || pkt.sourceId != UNIT_ID_RIVER) {
-        Serial.println("  Not from river unit - discarding");
+      if (pkt.msgType != MSG_TYPE_SENSOR || !isSensorSource(pkt.sourceId)) {
+        Serial.println("  Not from a sensor node - discarding");
         continue;
       }
 
@@ -208,7 +244,7 @@ void setup() {
       Serial.print(", Current: ");
       Serial.print(pkt.current_mA, 2);
       Serial.print(" mA, Moisture: ");
-      Serial.print(pkt.moisturePercent, 1);
+      Serial.print(pkt.moisture_dPct / 10.0, 1);
       Serial.println("%");
       Serial.print("  RSSI: ");
       Serial.print(rxRSSI);
@@ -219,20 +255,24 @@ void setup() {
       // Store for display
       lastRSSI = rxRSSI;
       lastCurrent = pkt.current_mA;
-      lastMoisture = pkt.moisturePercent;
+      lastMoisture = pkt.moisture_dPct / 10.0;
 
       // Modify packet for relay
       pkt.msgType = MSG_TYPE_RELAY;
       pkt.relayId = UNIT_ID_RIDGE;
       pkt.rssi = rxRSSI;
-      pkt.checksum = calculateChecksum(&pkt);
 
       // Small delay before retransmit
       delay(50);
 
       // Retransmit
       Serial.print("  Relaying... ");
-      state = radio.transmit((uint8_t*)&pkt, sizeof(SensorPacket));
+      if (compact) {
+        uint8_t frame[COMPACT_RELAY_FRAME_LEN];
+        state = radio.transmit(frame, encodeCompactFrame(&pkt, frame));
+      } else {
+        state = radio.transmit(packetEncode(&pkt), packetLength(&pkt));
+      }
 
       if (state == RADIOLIB_ERR_NONE) {
         Serial.println("OK");
@@ -244,10 +284,13 @@ void setup() {
       }
 
       // Update display with new data
-      updateDisplay(true, rxRSSI, pkt.current_mA, pkt.moisturePercent, packetsRelayed);
+      updateDisplay(true, rxRSSI, pkt.current_mA, pkt.moisture_dPct / 10.0, packetsRelayed);
 
-      // Exit listen loop - we relayed a packet
-      break;
+      // Keep listening briefly for a StormPacket or ChannelPacket, then exit
+      // the listen loop (with an implicit header nothing else can follow)
+      if (LORA_IMPLICIT_HEADER) break;
+      startTime = millis();
+      listenWindow = RELAY_FOLLOW_MS;
     }
 
     // Small delay to prevent busy-looping
@@ -292,14 +335,21 @@ void loop() {
     if (rxFlag) {
       rxFlag = false;
 
-      SensorPacket pkt;
-      int state = radio.readData((uint8_t*)&pkt, sizeof(SensorPacket));
+      RxFrame rx;
+      SensorPacket& pkt = rx.sensor;
+      size_t rxLen = radio.getPacketLength();
+      int state = radio.readData(rx.bytes, sizeof(rx.bytes));
+
+      bool batch = state == RADIOLIB_ERR_NONE && isBatchFrame(rx.bytes, rxLen);
+      bool compact = false;
+      bool valid = state == RADIOLIB_ERR_NONE && !batch &&
+                   unpackFrame(&pkt, rxLen, &compact);
 
       if (state == RADIOLIB_ERR_NONE) {
         // Validate and process packet
-        if (validateChecksum(&pkt) &&
+        if (valid &&
             pkt.msgType == MSG_TYPE_SENSOR &&
-            pkt.sourceId == UNIT_ID_RIVER &&
+            isSensorSource(pkt.sourceId) &&
             pkt.relayId == 0) {
 
           int rxRSSI = radio.getRSSI();
@@ -311,7 +361,7 @@ void loop() {
           Serial.print(", Current: ");
           Serial.print(pkt.current_mA, 2);
           Serial.print(" mA, Moisture: ");
-          Serial.print(pkt.moisturePercent, 1);
+          Serial.print(pkt.moisture_dPct / 10.0, 1);
           Serial.println("%");
           Serial.print("  RSSI: ");
           Serial.print(rxRSSI);
@@ -322,17 +372,21 @@ void loop() {
           // Store for display
           lastRSSI = rxRSSI;
           lastCurrent = pkt.current_mA;
-          lastMoisture = pkt.moisturePercent;
+          lastMoisture = pkt.moisture_dPct / 10.0;
 
           // Modify and relay
           pkt.msgType = MSG_TYPE_RELAY;
           pkt.relayId = UNIT_ID_RIDGE;
           pkt.rssi = rxRSSI;
-          pkt.checksum = calculateChecksum(&pkt);
 
           delay(50);
           Serial.print("  Relaying... ");
-          state = radio.transmit((uint8_t*)&pkt, sizeof(SensorPacket));
+          if (compact) {
+            uint8_t frame[COMPACT_RELAY_FRAME_LEN];
+            state = radio.transmit(frame, encodeCompactFrame(&pkt, frame));
+          } else {
+            state = radio.transmit(packetEncode(&pkt), packetLength(&pkt));
+          }
 
           if (state == RADIOLIB_ERR_NONE) {
             Serial.println("OK");
@@ -342,7 +396,19 @@ void loop() {
             Serial.println(state);
           }
 
-          updateDisplay(true, rxRSSI, pkt.current_mA, pkt.moisturePercent, packetsRelayed);
+          updateDisplay(true, rxRSSI, pkt.current_mA, pkt.moisture_dPct / 10.0, packetsRelayed);
+        } else if (valid &&
+                   pkt.msgType == MSG_TYPE_CHANNELS &&
+                   isSensorSource(pkt.sourceId) &&
+                   pkt.relayId == 0) {
+          relayChannelPacket(rx.bytes, rxLen, radio.getRSSI());
+        } else if (valid &&
+                   pkt.msgType == MSG_TYPE_STORM &&
+                   isSensorSource(pkt.sourceId) &&
+                   pkt.relayId == 0) {
+          relayStormPacket(rx.bytes, rxLen, radio.getRSSI());
+        } else if (batch) {
+          relayBatchFrame(rx.bytes, rxLen, radio.getRSSI());
         }
       }
 
@@ -354,6 +420,104 @@ void loop() {
   #endif
 }
 
+// Relay a ChannelPacket (extra INA219 channels) from the river unit
+bool relayChannelPacket(uint8_t* frame, size_t len, int rxRSSI) {
+  ChannelPacket* pkt = packetDecode<ChannelPacket>(frame, len);
+  if (!pkt) return false;
+
+  Serial.print("Channel packet received: Seq #");
+  Serial.print(pkt->sequence);
+  Serial.print(", ");
+  Serial.print(pkt->channelCount);
+  Serial.println(" channel(s)");
+
+  pkt->relayId = UNIT_ID_RIDGE;
+  pkt->rssi = rxRSSI;
+
+  delay(50);
+  Serial.print("  Relaying... ");
+  int state = radio.transmit(packetEncode(pkt), packetLength(pkt));
+
+  if (state == RADIOLIB_ERR_NONE) {
+    Serial.println("OK");
+    packetsRelayed++;
+    return true;
+  }
+
+  Serial.print("FAILED! Error: ");
+  Serial.println(state);
+  return false;
+}
+
+// Batched readings: relay fields go in place, the readings stay packed
+bool relayBatchFrame(uint8_t* frame, size_t len, int rxRSSI) {
+  SensorBatch batch;
+  if (!decodeBatchFrame(&batch, frame, len)) {
+    Serial.println("  Batch CRC invalid - discarding");
+    return false;
+  }
+  if (!isSensorSource(batch.sourceId) || batch.relayId != 0) {
+    Serial.println("  Not a direct batch from a sensor node - discarding");
+    return false;
+  }
+
+  const BatchReading* latest = &batch.readings[batch.count - 1];
+  lastRSSI = rxRSSI;
+  lastCurrent = latest->current_cmA / 100.0;
+  lastMoisture = latest->moisture / 2.0;
+
+  Serial.print("Batch packet received: Seq #");
+  Serial.print(batch.sequence);
+  Serial.print(", ");
+  Serial.print(batch.count);
+  Serial.print(" readings, latest ");
+  Serial.print(lastCurrent, 2);
+  Serial.println(" mA");
+
+  len = appendBatchRelay(frame, len, UNIT_ID_RIDGE, rxRSSI);
+
+  delay(50);
+  Serial.print("  Relaying... ");
+  int state = radio.transmit(frame, len);
+
+  if (state != RADIOLIB_ERR_NONE) {
+    Serial.print("FAILED! Error: ");
+    Serial.println(state);
+    return false;
+  }
+
+  Serial.println("OK");
+  packetsRelayed++;
+  updateDisplay(true, rxRSSI, lastCurrent, lastMoisture, packetsRelayed);
+  return true;
+}
+
+// Relay a StormPacket (burst summary) from the river unit
+bool relayStormPacket(uint8_t* frame, size_t len, int rxRSSI) {
+  StormPacket* pkt = packetDecode<StormPacket>(frame, len);
+  if (!pkt) return false;
+
+  Serial.print("Storm packet received: Seq #");
+  Serial.println(pkt->sequence);
+
+  pkt->relayId = UNIT_ID_RIDGE;
+  pkt->rssi = rxRSSI;
+
+  delay(50);
+  Serial.print("  Relaying... ");
+  int state = radio.transmit(packetEncode(pkt), packetLength(pkt));
+
+  if (state == RADIOLIB_ERR_NONE) {
+    Serial.println("OK");
+    packetsRelayed++;
+    return true;
+  }
+
+  Serial.print("FAILED! Error: ");
+  Serial.println(state);
+  return false;
+}
+
 bool initLoRa() {
   Serial.print("Initializing LoRa... ");
 
@@ -379,6 +543,19 @@ bool initLoRa() {
     return false;
   }
 
+  // Implicit header: length, coding rate and CRC come from lora_config.h
+  #if LORA_IMPLICIT_HEADER
+    state = radio.implicitHeader(LORA_IMPLICIT_LEN);
+    if (state == RADIOLIB_ERR_NONE) {
+      state = radio.setCRC(LORA_CRC_BYTES);
+    }
+    if (state != RADIOLIB_ERR_NONE) {
+      Serial.print("FAILED! Implicit header error: ");
+      Serial.println(state);
+      return false;
+    }
+  #endif
+
   Serial.println("OK");
   return true;
 }
@@ -432,7 +609,7 @@ void updateDisplay(bool hasData, int rssi, float current, float moisture, uint32
     // Calculate and show depth in inches
     float depthCm = 0;
     if (current >= 4.0) {
-      depthCm = ((current - 4.0) / (20.0 - 4.0)) * 100.0;  // MAX_DEPTH_CM = 100
+      depthCm = calDepthMm(depthCal, lroundf(current * 1000.0)) / 10.0;
     }
     float depthInches = depthCm * 0.393701;
     display.setCursor(0, 34);
@@ -10,6 +10,9 @@
 #ifndef LORA_CONFIG_H
 #define LORA_CONFIG_H
 
+#include <string.h>
+#include "packet_crc.h"
+
 // ===== LoRa Radio Settings =====
 // These MUST be identical on all three units!
 
@@ -20,6 +23,18 @@
 #define LORA_SYNC_WORD      0x12     // Private network sync word (must match all units)
 #define LORA_TX_POWER       14       // dBm (-9 to 22, 14 is good for <1km)
 #define LORA_PREAMBLE       8        // Preamble length (8 is standard)
+#define LORA_CRC_BYTES      2        // LoRa payload CRC (RadioLib default)
+
+// Implicit header: the LoRa header (payload length, coding rate, CRC flag)
+// is left off every packet and both ends take those values from above.
+// Each frame on air must then be exactly LORA_IMPLICIT_LEN bytes, so the
+// network carries only compact sensor frames - direct frames carry zeroed
+// relay fields, and ChannelPacket, StormPacket and batch frames can't be
+// sent. Each relayed hop takes 7 fewer payload symbols (~29 ms at SF9), and
+// relays stop listening as soon as they have relayed, since no follow-up
+// packet can come.
+#define LORA_IMPLICIT_HEADER false
+#define LORA_IMPLICIT_LEN   COMPACT_RELAY_FRAME_LEN
 
 // Heltec V3 SX1262 Pin Definitions
 #define LORA_NSS            8        // SPI Chip Select
@@ -36,11 +51,21 @@
 // ===== Message Protocol =====
 // Simple packet format for sensor data
 
+// SensorPacket layout version, carried in the top two bits of its msgType.
+// Version 0 sent moisture as a float; version 1 splits those four bytes into
+// moisture_dPct and faultFlags. Firmware from before the split only accepts
+// msgType 0x01/0x02, so it drops a version 1 packet as an unknown type
+// instead of misreading the moisture bytes.
+#define SENSOR_PACKET_VERSION 1
+
 // Message types
-#define MSG_TYPE_SENSOR     0x01     // Sensor data from river unit
-#define MSG_TYPE_RELAY      0x02     // Relayed sensor data from ridge
+#define MSG_TYPE_SENSOR     (SENSOR_PACKET_VERSION << 6 | 0x01)  // Sensor data from river unit
+#define MSG_TYPE_RELAY      (SENSOR_PACKET_VERSION << 6 | 0x02)  // Relayed sensor data from ridge
 #define MSG_TYPE_ACK        0x03     // Acknowledgment (optional)
 #define MSG_TYPE_STATUS     0x04     // Status/heartbeat
+#define MSG_TYPE_CHANNELS   0x05     // Per-channel currents (multi-INA219 river unit)
+#define MSG_TYPE_STORM      0x06     // Storm-mode burst summary (river unit)
+#define MSG_TYPE_BATCH      0x07     // Batched readings (river unit, compact frame only)
 
 // Network IDs (to identify units)
 #define UNIT_ID_RIVER       0x01     // River sensor unit
@@ -48,11 +73,23 @@
 #define UNIT_ID_RIDGE2      0x05     // Ridge relay unit (secondary - T-Deck, 300ms delay)
 #define UNIT_ID_HOME        0x03     // Home receiver unit
 
+// Every other ID (1-255) is free for sensor nodes, one each; the river unit
+// sends NODE_ID. Compact and batch frames carry 6 bits of it (IDs up to
+// COMPACT_SOURCE_ID_MAX, 63 - 60 sensor nodes).
+
+constexpr bool isSensorSource(uint8_t id) {
+  return id != 0 && id != UNIT_ID_RIDGE && id != UNIT_ID_RIDGE2 && id != UNIT_ID_HOME;
+}
+
 // ===== Timing Settings =====
 
 // River Unit: How often to transmit (milliseconds)
 #define TX_INTERVAL_MS      10000    // 10 seconds (matches sensor read interval)
 
+// River Unit: Random delay (0..N ms) added to each TX slot. Slots stay on a
+// fixed TX_INTERVAL_MS grid, so a packet arrives within N ms of its slot
+#define TX_SLOT_JITTER_MS   0
+
 // Ridge Relay: Deep sleep duration between wake cycles (seconds)
 #define RELAY_SLEEP_SEC     8        // Wake every 8 seconds to check for messages
                                      // Must be less than TX_INTERVAL to catch transmissions
@@ -60,8 +97,21 @@
 // Ridge Relay: How long to listen after waking (milliseconds)
 #define RELAY_LISTEN_MS     3000     // 3 seconds listening window
 
+// River Unit: Delay between a SensorPacket and each packet that follows it
+// (StormPacket, then ChannelPacket). Long enough for both relays to finish
+// retransmitting the previous packet
+#define CHANNEL_TX_DELAY_MS 1000
+
+// Ridge Relay: After relaying a SensorPacket or StormPacket, keep listening
+// this long for the follow-up packet
+#define RELAY_FOLLOW_MS     1500
+
+// River Unit: Longest silence when the level is steady (report by exception)
+#define REPORT_HEARTBEAT_MS 600000   // 10 minutes
+
 // Home Unit: Timeout to consider connection lost (milliseconds)
-#define RX_TIMEOUT_MS       60000    // 60 seconds without data = connection lost
+// Two missed heartbeats plus margin
+#define RX_TIMEOUT_MS       (2 * REPORT_HEARTBEAT_MS + 60000)
 
 // ===== Data Packet Structure =====
 // Total: 16 bytes fixed size for reliable transmission
@@ -72,26 +122,761 @@ typedef struct __attribute__((packed)) {
   uint8_t  relayId;         // Relay ID (0 if direct, UNIT_ID_RIDGE if relayed)
   uint8_t  sequence;        // Sequence number (0-255, wraps)
   float    current_mA;      // INA219 current reading (4 bytes)
-  float    moisturePercent; // Moisture sensor reading (4 bytes)
+  uint16_t moisture_dPct;   // Moisture sensor reading, 0.1 % (2 bytes)
+  uint16_t faultFlags;      // Sensor self-diagnostics, DIAG_* bits (2 bytes)
   int16_t  rssi;            // RSSI at relay (or 0 if direct) (2 bytes)
   uint8_t  batteryPercent;  // Battery level of sender (0-100)
   uint8_t  checksum;        // Simple checksum for validation
 } SensorPacket;
 
-// Calculate simple checksum
-inline uint8_t calculateChecksum(SensorPacket* pkt) {
+// ===== Sensor Fault Bits (SensorPacket.faultFlags) =====
+// Set by the river unit's self-diagnostics (sensor_diag.h) so receivers can
+// flag suspect readings without seeing the raw samples.
+
+#define DIAG_LOOP_OPEN           0x0001   // Loop current < 3.6 mA (broken loop / dead sensor)
+#define DIAG_LOOP_OVER           0x0002   // Loop current > 20.5 mA (over-range / short)
+#define DIAG_CURRENT_STUCK       0x0004   // Loop current not moving at all
+#define DIAG_CURRENT_JUMP        0x0008   // Implausible step in loop current
+#define DIAG_MOISTURE_SATURATED  0x0010   // Moisture probe pinned wet (shorted)
+#define DIAG_MOISTURE_DRY_STUCK  0x0020   // Moisture probe pinned dry (open / disconnected)
+#define DIAG_NO_CURRENT_SENSOR   0x0040   // No INA219 fitted - depth unavailable
+#define DIAG_FAULT_COUNT         7
+
+// Short names, indexed by bit number
+static const char* const DIAG_FAULT_NAMES[DIAG_FAULT_COUNT] = {
+  "LOOP OPEN", "LOOP OVER", "CURRENT STUCK", "CURRENT JUMP",
+  "MOIST SAT", "MOIST DRY", "NO INA219"
+};
+
+// Calculate simple checksum over all bytes except the last (checksum field)
+inline uint8_t calculateChecksumBytes(const uint8_t* data, size_t len) {
   uint8_t sum = 0;
-  uint8_t* data = (uint8_t*)pkt;
-  // Sum all bytes except the last one (checksum field)
-  for (int i = 0; i < sizeof(SensorPacket) - 1; i++) {
+  for (size_t i = 0; i < len - 1; i++) {
     sum ^= data[i];  // XOR checksum
   }
   return sum;
 }
 
-// Validate checksum
-inline bool validateChecksum(SensorPacket* pkt) {
+// ===== Packet Schema =====
+// Each fixed-layout message is a packed struct that is its own wire image
+// (the ESP32 and any host that builds these headers are little-endian). A
+// message type is declared once - the struct, then PACKET_SCHEMA() beside
+// it - and the templates below generate the rest for every type:
+//   calculateChecksum / validateChecksum   XOR over all bytes but the last
+//   packetEncode   seal the checksum; the struct itself is the frame to send
+//   packetDecode   check length, msgType and checksum, then use the received
+//                  frame as the struct in place
+// Neither copies the packet or touches a field by name, so a field added to
+// the struct needs no codec change; the static_asserts in PACKET_SCHEMA()
+// stop a struct whose size or header no longer matches the wire format.
+//
+// Format versions: the top two bits of byte 0 are the format version of
+// every frame. SensorPacket is version SENSOR_PACKET_VERSION (1), ChannelPacket
+// and StormPacket are version 0; compact and batch frames carry 1 to 3 and
+// are told apart from fixed-layout frames by length. A broadcast link has no handshake,
+// so the versions are agreed at build time instead: receivers decode every
+// version up to PACKET_VERSION_MAX and drop anything newer before decoding,
+// and a sender can't be built to send a version its receivers don't know.
+
+#define PACKET_FIXED_LEN        16       // Fixed-layout frames
+#define PACKET_VERSION_MAX      3        // Newest format receivers decode
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "Fixed-layout packets go on air as little-endian structs");
+
+// Bit-packed frames (the header byte, the compact field words and the batch
+// header) are declared the same way: one WireField per field in a table.
+// The codecs only touch a field through wirePut()/wireGet() on its entry,
+// wireFieldsValid() checks each table, and the static_asserts after each
+// table pin it to the layout documented above it.
+typedef struct {
+  uint8_t shift;            // First bit in the word
+  uint8_t bits;             // Width
+} WireField;
+
+constexpr uint32_t wireMax(WireField f) {
+  return (uint32_t)((1ULL << f.bits) - 1);
+}
+
+constexpr uint32_t wirePut(WireField f, uint32_t v) {
+  return (v & wireMax(f)) << f.shift;
+}
+
+constexpr uint32_t wireGet(WireField f, uint64_t word) {
+  return (uint32_t)(word >> f.shift) & wireMax(f);
+}
+
+// Fields fit a word of wordBits without overlapping
+constexpr bool wireFieldsValid(const WireField* fields, size_t count, uint8_t wordBits) {
+  uint64_t used = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (fields[i].bits == 0 || fields[i].shift + fields[i].bits > wordBits) return false;
+    uint64_t mask = (uint64_t)wireMax(fields[i]) << fields[i].shift;
+    if (used & mask) return false;
+    used |= mask;
+  }
+  return true;
+}
+
+// Byte 0 of every frame: [7:6] format version. Version 1 and 2 compact and
+// batch frames also carry [5:3] msgType and [2:0] sourceId; version 3 uses
+// all six bits for sourceId and tells compact from batch frames by length.
+constexpr WireField FRAME_SOURCE    = { 0, 3 };
+constexpr WireField FRAME_TYPE      = { 3, 3 };
+constexpr WireField FRAME_VERSION   = { 6, 2 };
+constexpr WireField FRAME_V3_SOURCE = { 0, 6 };
+
+#define COMPACT_SOURCE_ID_MAX   wireMax(FRAME_V3_SOURCE)
+
+constexpr WireField FRAME_HEADER_FIELDS[] = { FRAME_SOURCE, FRAME_TYPE, FRAME_VERSION };
+constexpr WireField FRAME_V3_HEADER_FIELDS[] = { FRAME_V3_SOURCE, FRAME_VERSION };
+
+// Version 1 and 2 header
+constexpr uint8_t frameHeader(uint8_t version, uint8_t msgType, uint8_t sourceId) {
+  return wirePut(FRAME_VERSION, version) | wirePut(FRAME_TYPE, msgType) | wirePut(FRAME_SOURCE, sourceId);
+}
+
+// Version 3 header
+constexpr uint8_t frameHeaderV3(uint8_t sourceId) {
+  return wirePut(FRAME_VERSION, 3) | wirePut(FRAME_V3_SOURCE, sourceId);
+}
+
+static_assert(wireFieldsValid(FRAME_HEADER_FIELDS, 3, 8) && wireFieldsValid(FRAME_V3_HEADER_FIELDS, 2, 8),
+              "Header fields overlap or overflow byte 0");
+static_assert(frameHeader(2, MSG_TYPE_BATCH, 7) == 0xBF && frameHeader(1, MSG_TYPE_SENSOR, 1) == 0x49,
+              "Version 1-2 header byte must be [7:6] version, [5:3] msgType, [2:0] sourceId");
+static_assert(frameHeaderV3(63) == 0xFF && frameHeaderV3(1) == 0xC1,
+              "Version 3 header byte must be [7:6] version, [5:0] sourceId");
+static_assert(wireMax(FRAME_VERSION) >= PACKET_VERSION_MAX, "Version field can't hold PACKET_VERSION_MAX");
+static_assert(wireGet(FRAME_VERSION, MSG_TYPE_SENSOR) == SENSOR_PACKET_VERSION &&
+              wireGet(FRAME_VERSION, MSG_TYPE_RELAY) == SENSOR_PACKET_VERSION,
+              "SensorPacket msgTypes must carry SENSOR_PACKET_VERSION");
+static_assert(SENSOR_PACKET_VERSION <= PACKET_VERSION_MAX, "Receivers can't decode SENSOR_PACKET_VERSION");
+
+inline uint8_t frameVersion(const uint8_t* frame) {
+  return wireGet(FRAME_VERSION, frame[0]);
+}
+
+inline uint8_t frameType(const uint8_t* frame) {
+  return wireGet(FRAME_TYPE, frame[0]);
+}
+
+inline uint8_t frameSource(const uint8_t* frame) {
+  return frameVersion(frame) >= 3 ? wireGet(FRAME_V3_SOURCE, frame[0]) : wireGet(FRAME_SOURCE, frame[0]);
+}
+
+inline bool frameVersionSupported(const uint8_t* frame, size_t len) {
+  return len > 0 && frameVersion(frame) <= PACKET_VERSION_MAX;
+}
+
+template <typename T> struct PacketSchema;   // Specialised by PACKET_SCHEMA()
+
+// type: the struct; sentType: msgType from the sender; relayedType: msgType
+// once a relay has forwarded it
+#define PACKET_SCHEMA(type, sentType, relayedType)                                  \
+  template <> struct PacketSchema<type> {                                           \
+    static constexpr uint8_t msgType = sentType;                                    \
+    static constexpr uint8_t relayedMsgType = relayedType;                          \
+    static constexpr size_t  length = sizeof(type);                                 \
+  };                                                                                \
+  static_assert(sizeof(type) == PACKET_FIXED_LEN, #type " must be 16 bytes on air"); \
+  static_assert(offsetof(type, msgType) == 0 && offsetof(type, sourceId) == 1 &&    \
+                offsetof(type, relayId) == 2 && offsetof(type, sequence) == 3,      \
+                #type " must start msgType, sourceId, relayId, sequence");         \
+  static_assert(offsetof(type, checksum) == PACKET_FIXED_LEN - 1,                   \
+                #type " must end with its checksum");                               \
+  static_assert(wireGet(FRAME_VERSION, sentType) == wireGet(FRAME_VERSION, relayedType) && \
+                wireGet(FRAME_VERSION, sentType) <= PACKET_VERSION_MAX,             \
+                #type " msgType must carry one format version receivers decode")
+
+template <typename T>
+inline uint8_t calculateChecksum(const T* pkt) {
+  return calculateChecksumBytes((const uint8_t*)pkt, PacketSchema<T>::length);
+}
+
+template <typename T>
+inline bool validateChecksum(const T* pkt) {
   return pkt->checksum == calculateChecksum(pkt);
 }
 
+template <typename T>
+constexpr size_t packetLength(const T*) {
+  return PacketSchema<T>::length;
+}
+
+// Seal the checksum and return the frame to send (packetLength() bytes)
+template <typename T>
+inline uint8_t* packetEncode(T* pkt) {
+  pkt->checksum = calculateChecksum(pkt);
+  return (uint8_t*)pkt;
+}
+
+// The received frame as a T, in place, or nullptr if it isn't a valid one
+template <typename T>
+inline T* packetDecode(uint8_t* frame, size_t len) {
+  if (len != PacketSchema<T>::length) return nullptr;
+  if (frame[0] != PacketSchema<T>::msgType && frame[0] != PacketSchema<T>::relayedMsgType) {
+    return nullptr;
+  }
+  T* pkt = (T*)frame;
+  return validateChecksum(pkt) ? pkt : nullptr;
+}
+
+PACKET_SCHEMA(SensorPacket, MSG_TYPE_SENSOR, MSG_TYPE_RELAY);
+
+// ===== Compact Sensor Frame =====
+// The river unit's SensorPacket goes on air as an 8-byte frame instead of
+// the 16-byte struct (22 instead of 36 payload symbols at SF9/CR4-7, about
+// 57 ms less airtime per hop). Relays append their ID and RSSI (10 bytes).
+// Receivers expand it back into a SensorPacket with expandCompactFrame(), so
+// everything after the radio still works on SensorPacket.
+//
+// Format version 3 (sent by current firmware):
+//   byte 0      header: [7:6] format version, [5:0] sourceId (up to 63)
+//   byte 1      sequence
+//   bytes 2-5   32-bit little-endian field word:
+//                 [11:0]  current, 0.01 mA (0-40.95 mA)
+//                 [19:12] moisture, 0.5 % (0-200)
+//                 [26:20] faultFlags (DIAG_* bits 0-6)
+//                 [31:27] battery, 1/31 of full (~3 % steps)
+//   relayed:    relayId, RSSI at relay (int8 dBm)
+//   last 2      CRC-16/CCITT-FALSE of every byte before it (little-endian)
+// There is no msgType field: a frame with relayId set is MSG_TYPE_RELAY,
+// otherwise MSG_TYPE_SENSOR.
+//
+// Accepted from older river units:
+//   version 2   header [7:6] version, [5:3] msgType, [2:0] sourceId (up to
+//               7), otherwise as version 3
+//   version 1   version 2 header, a 40-bit field word (current 12,
+//               moisture 8, battery % 7, faults 7, reserved 6 bits) and a
+//               1-byte XOR checksum
+//
+// 16-byte SensorPackets (SENSOR_PACKET_VERSION in their msgType) are told
+// apart by length, so receivers accept every format. ChannelPacket and StormPacket stay 16-byte
+// XOR-checked frames.
+
+#define SENSOR_PACKET_COMPACT   true     // River unit sends compact frames
+
+#define COMPACT_FORMAT_VERSION  3        // Version sent (1 = XOR, 2 = CRC-16, 3 = 6-bit sourceId)
+#define COMPACT_FRAME_LEN       8        // Direct from the river unit
+#define COMPACT_RELAY_FRAME_LEN 10       // With relayId + RSSI appended
+
+static_assert(COMPACT_FORMAT_VERSION <= PACKET_VERSION_MAX,
+              "Receivers can't decode the compact format version being sent");
+static_assert(COMPACT_FORMAT_VERSION == 3, "encodeCompactFrame() and encodeBatchFrame() write version 3");
+static_assert(COMPACT_RELAY_FRAME_LEN <= sizeof(SensorPacket),
+              "Receivers read compact frames into a SensorPacket buffer");
+
+// Version 2 field word, one entry per field. The codec, the limits below and
+// the batch delta widths all follow from this table.
+constexpr WireField COMPACT_CURRENT  = {  0, 12 };   // 0.01 mA
+constexpr WireField COMPACT_MOISTURE = { 12,  8 };   // 0.5 %
+constexpr WireField COMPACT_FAULTS   = { 20,  7 };   // DIAG_* bits
+constexpr WireField COMPACT_BATTERY  = { 27,  5 };   // 1/31 of full
+
+constexpr WireField COMPACT_FIELDS[] = {
+  COMPACT_CURRENT, COMPACT_MOISTURE, COMPACT_FAULTS, COMPACT_BATTERY
+};
+
+static_assert(wireFieldsValid(COMPACT_FIELDS, sizeof(COMPACT_FIELDS) / sizeof(COMPACT_FIELDS[0]), 32),
+              "Compact fields overlap or overflow the field word");
+static_assert(wireMax(COMPACT_MOISTURE) >= 200, "Compact moisture must hold 0-100 % in 0.5 % steps");
+static_assert(DIAG_FAULT_COUNT <= COMPACT_FAULTS.bits, "Compact frame must carry every fault bit");
+
+#define COMPACT_CURRENT_MAX     wireMax(COMPACT_CURRENT)   // 40.95 mA
+#define COMPACT_FAULT_MASK      wireMax(COMPACT_FAULTS)    // DIAG_* bits carried on air
+#define COMPACT_BATTERY_STEPS   wireMax(COMPACT_BATTERY)
+
+// Version 1 field word (40 bits, decoded only)
+constexpr WireField COMPACT_V1_CURRENT  = {  0, 12 };   // 0.01 mA
+constexpr WireField COMPACT_V1_MOISTURE = { 12,  8 };   // 0.5 %
+constexpr WireField COMPACT_V1_BATTERY  = { 20,  7 };   // Whole percent
+constexpr WireField COMPACT_V1_FAULTS   = { 27,  7 };   // DIAG_* bits
+
+constexpr WireField COMPACT_V1_FIELDS[] = {
+  COMPACT_V1_CURRENT, COMPACT_V1_MOISTURE, COMPACT_V1_BATTERY, COMPACT_V1_FAULTS
+};
+
+static_assert(wireFieldsValid(COMPACT_V1_FIELDS, sizeof(COMPACT_V1_FIELDS) / sizeof(COMPACT_V1_FIELDS[0]), 40),
+              "Version 1 fields overlap or overflow the field word");
+
+// Payload symbols for a frame (SX126x datasheet 6.1.4). RadioLib turns on
+// low data rate optimisation when a symbol lasts 16 ms or more.
+constexpr uint16_t loraPayloadSymbols(uint16_t len, bool implicitHeader) {
+  int32_t ldro = (1 << LORA_SPREADING) / LORA_BANDWIDTH >= 16.0 ? 1 : 0;
+  int32_t perBlock = 4 * (LORA_SPREADING - 2 * ldro);
+  int32_t bits = 8 * len - 4 * LORA_SPREADING + 28 + (LORA_CRC_BYTES ? 16 : 0) -
+                 (implicitHeader ? 20 : 0);
+  int32_t blocks = bits > 0 ? (bits + perBlock - 1) / perBlock : 0;
+  return 8 + blocks * LORA_CODING_RATE;
+}
+
+#if LORA_IMPLICIT_HEADER
+static_assert(SENSOR_PACKET_COMPACT, "Implicit header mode carries compact sensor frames only");
+static_assert(LORA_IMPLICIT_LEN == COMPACT_RELAY_FRAME_LEN,
+              "Implicit frame length must be the compact frame with relay fields");
+static_assert(loraPayloadSymbols(LORA_IMPLICIT_LEN, true) <= loraPayloadSymbols(COMPACT_FRAME_LEN, false),
+              "Implicit frames would take longer than explicit direct frames");
+#endif
+
+inline bool isCompactFrame(const uint8_t* frame, size_t len) {
+  uint8_t version = frameVersion(frame);
+  if (len != COMPACT_FRAME_LEN && len != COMPACT_RELAY_FRAME_LEN) return false;
+  return version == 3 || ((version == 1 || version == 2) && frameType(frame) != MSG_TYPE_BATCH);
+}
+
+// Version 2 field word. current_cmA is in 0.01 mA, moisture in 0.5 %.
+constexpr uint32_t packCompactFields(uint32_t current_cmA, uint32_t moisture,
+                                  uint16_t faultFlags, uint8_t batteryPercent) {
+  if (current_cmA > COMPACT_CURRENT_MAX) current_cmA = COMPACT_CURRENT_MAX;
+  if (moisture > 200) moisture = 200;
+  uint32_t battery = batteryPercent > 100 ? 100 : batteryPercent;
+  battery = (battery * COMPACT_BATTERY_STEPS + 50) / 100;
+
+  return wirePut(COMPACT_CURRENT, current_cmA) |
+         wirePut(COMPACT_MOISTURE, moisture) |
+         wirePut(COMPACT_FAULTS, faultFlags) |
+         wirePut(COMPACT_BATTERY, battery);
+}
+
+static_assert(packCompactFields(4095, 0, 0, 0) == 0x00000FFF &&
+              packCompactFields(0, 200, 0, 0) == 200UL << 12 &&
+              packCompactFields(0, 0, 0x7F, 0) == 0x7FUL << 20 &&
+              packCompactFields(0, 0, 0, 100) == 31UL << 27,
+              "Version 2 word must be current [11:0], moisture [19:12], faults [26:20], battery [31:27]");
+
+inline void unpackCompactFields(uint32_t fields, uint32_t* current_cmA, uint32_t* moisture,
+                                uint32_t* faults, uint32_t* battery) {
+  *current_cmA = wireGet(COMPACT_CURRENT, fields);
+  *moisture = wireGet(COMPACT_MOISTURE, fields);
+  *faults = wireGet(COMPACT_FAULTS, fields);
+  *battery = (wireGet(COMPACT_BATTERY, fields) * 100 + COMPACT_BATTERY_STEPS / 2) / COMPACT_BATTERY_STEPS;
+}
+
+// Encode a SensorPacket (format version 3); relay fields are appended when
+// relayId is set or the header is implicit. Returns the frame length.
+inline size_t encodeCompactFrame(const SensorPacket* pkt, uint8_t* frame) {
+  long current_cmA = lroundf(pkt->current_mA * 100.0f);
+  if (current_cmA < 0) current_cmA = 0;
+  uint32_t fields = packCompactFields(current_cmA, (pkt->moisture_dPct + 2) / 5,
+                                      pkt->faultFlags, pkt->batteryPercent);
+
+  frame[0] = frameHeaderV3(pkt->sourceId);
+  frame[1] = pkt->sequence;
+  for (uint8_t i = 0; i < 4; i++) {
+    frame[2 + i] = (uint8_t)(fields >> (8 * i));
+  }
+
+  size_t len = COMPACT_FRAME_LEN;
+  if (pkt->relayId != 0 || LORA_IMPLICIT_HEADER) {
+    frame[6] = pkt->relayId;
+    frame[7] = (uint8_t)(int8_t)(pkt->rssi < -128 ? -128 : pkt->rssi > 127 ? 127 : pkt->rssi);
+    len = COMPACT_RELAY_FRAME_LEN;
+  }
+  uint16_t crc = crc16(frame, len - 2);
+  frame[len - 2] = (uint8_t)crc;
+  frame[len - 1] = (uint8_t)(crc >> 8);
+  return len;
+}
+
+// Expand a compact frame held in a SensorPacket-sized receive buffer into a
+// SensorPacket (with a valid checksum). Returns false on a bad CRC/checksum.
+inline bool expandCompactFrame(SensorPacket* pkt, size_t len) {
+  uint8_t frame[COMPACT_RELAY_FRAME_LEN];
+  memcpy(frame, pkt, len);
+  uint8_t version = frameVersion(frame);
+  bool relayed = len == COMPACT_RELAY_FRAME_LEN;
+
+  uint32_t current_cmA, moisture, battery, faults;
+  uint8_t relayAt;
+  if (version >= 2) {
+    uint16_t crc = frame[len - 2] | (uint16_t)frame[len - 1] << 8;
+    if (crc != crc16(frame, len - 2)) return false;
+
+    uint32_t fields = 0;
+    for (uint8_t i = 0; i < 4; i++) {
+      fields |= (uint32_t)frame[2 + i] << (8 * i);
+    }
+    unpackCompactFields(fields, &current_cmA, &moisture, &faults, &battery);
+    relayAt = 6;
+  } else {
+    if (frame[len - 1] != calculateChecksumBytes(frame, len)) return false;
+
+    uint64_t fields = 0;
+    for (uint8_t i = 0; i < 5; i++) {
+      fields |= (uint64_t)frame[2 + i] << (8 * i);
+    }
+    current_cmA = wireGet(COMPACT_V1_CURRENT, fields);
+    moisture = wireGet(COMPACT_V1_MOISTURE, fields);
+    battery = wireGet(COMPACT_V1_BATTERY, fields);
+    faults = wireGet(COMPACT_V1_FAULTS, fields) & COMPACT_FAULT_MASK;
+    relayAt = 7;
+  }
+
+  memset(pkt, 0, sizeof(SensorPacket));
+  pkt->msgType = wirePut(FRAME_VERSION, SENSOR_PACKET_VERSION) | frameType(frame);
+  pkt->sourceId = frameSource(frame);
+  pkt->sequence = frame[1];
+  pkt->current_mA = current_cmA / 100.0f;
+  pkt->moisture_dPct = moisture * 5;
+  pkt->batteryPercent = battery;
+  pkt->faultFlags = faults;
+  if (relayed) {
+    pkt->relayId = frame[relayAt];
+    pkt->rssi = (int8_t)frame[relayAt + 1];
+  }
+  if (version >= 3) {
+    pkt->msgType = pkt->relayId ? MSG_TYPE_RELAY : MSG_TYPE_SENSOR;
+  }
+  pkt->checksum = calculateChecksum(pkt);
+  return true;
+}
+
+// Check a received frame (read into a SensorPacket-sized buffer) and expand
+// it if compact. compact reports the format so a relay can forward it as-is.
+inline bool unpackFrame(SensorPacket* pkt, size_t len, bool* compact) {
+  *compact = false;
+  if (!frameVersionSupported((uint8_t*)pkt, len)) return false;
+  *compact = isCompactFrame((uint8_t*)pkt, len);
+  if (*compact) return expandCompactFrame(pkt, len);
+  return len == sizeof(SensorPacket) && validateChecksum(pkt);
+}
+
+// ===== Batched Reading Frame =====
+// With BATCH_UPLINK the river unit queues every reading and sends several
+// in one frame instead of one frame each, so the preamble, header and CRC
+// are paid once per batch. The oldest reading is the base, sent in full;
+// each later one is its difference from the reading before, bit-packed at
+// the smallest width that holds the largest difference in the batch. A
+// steady river needs well under a byte per extra reading.
+//
+//   byte 0      header: [7:6] version 3, [5:0] sourceId; at least 14 bytes
+//               long, so never taken for a compact frame
+//   byte 1      sequence
+//   byte 2      [4:0] reading count (1-BATCH_MAX_READINGS),
+//               [5] base reading taken on a rain onset, [7] relayed
+//   bytes 3-6   base reading as a compact 32-bit field word; faults and
+//               battery are the state when the batch was sent
+//   bytes 7-8   age of the base reading when sent, seconds (little-endian)
+//   byte 9      nominal step between readings, seconds
+//   byte 10     [3:0] current delta width, [7:4] moisture delta width (bits)
+//   byte 11     [3:0] time delta width (bits), [7:4] reserved (0)
+//   then        per reading after the base, LSB first: time step minus the
+//               nominal step, current delta (0.01 mA), moisture delta
+//               (0.5 %), all zigzag coded, then 1 rain-onset bit
+//   relayed:    relayId, RSSI at relay (int8 dBm)
+//   last 2      CRC-16/CCITT-FALSE of every byte before it (little-endian)
+//
+// Version 2 batches from older river units have the version 2 header
+// ([5:3] MSG_TYPE_BATCH, [2:0] sourceId) and are otherwise the same.
+//
+// Ages are limited to 18 h and a single step to about 4.5 h. Relays append
+// their fields in place with appendBatchRelay(); the home unit expands the
+// batch back into one SensorPacket per reading.
+
+#define BATCH_MAX_READINGS      16
+#define BATCH_HEADER_LEN        12
+
+// Header bytes 2, 10 and 11
+constexpr WireField BATCH_HDR_COUNT         = { 0, 5 };   // Byte 2
+constexpr WireField BATCH_HDR_RAIN          = { 5, 1 };
+constexpr WireField BATCH_HDR_RELAYED       = { 7, 1 };
+constexpr WireField BATCH_HDR_CURRENT_BITS  = { 0, 4 };   // Byte 10
+constexpr WireField BATCH_HDR_MOISTURE_BITS = { 4, 4 };
+constexpr WireField BATCH_HDR_TIME_BITS     = { 0, 4 };   // Byte 11
+
+constexpr WireField BATCH_HDR_BYTE2[]  = { BATCH_HDR_COUNT, BATCH_HDR_RAIN, BATCH_HDR_RELAYED };
+constexpr WireField BATCH_HDR_BYTE10[] = { BATCH_HDR_CURRENT_BITS, BATCH_HDR_MOISTURE_BITS };
+
+#define BATCH_COUNT_MASK        wireMax(BATCH_HDR_COUNT)
+#define BATCH_BASE_RAIN         wirePut(BATCH_HDR_RAIN, 1)
+#define BATCH_RELAYED           wirePut(BATCH_HDR_RELAYED, 1)
+#define BATCH_CURRENT_BITS_MAX  (COMPACT_CURRENT.bits + 1)    // Zigzag of a difference
+#define BATCH_MOISTURE_BITS_MAX (COMPACT_MOISTURE.bits + 1)
+#define BATCH_TIME_BITS_MAX     15
+#define BATCH_READING_BITS_MAX  (BATCH_TIME_BITS_MAX + BATCH_CURRENT_BITS_MAX + BATCH_MOISTURE_BITS_MAX + 1)
+#define BATCH_FRAME_MAX_LEN     (BATCH_HEADER_LEN + \
+                                 ((BATCH_MAX_READINGS - 1) * BATCH_READING_BITS_MAX + 7) / 8 + 4)
+
+#define BATCH_READING_RAIN      0x01     // BatchReading.flags: taken on a rain onset
+
+static_assert(wireFieldsValid(BATCH_HDR_BYTE2, 3, 8) && wireFieldsValid(BATCH_HDR_BYTE10, 2, 8) &&
+              wireFieldsValid(&BATCH_HDR_TIME_BITS, 1, 8), "Batch header fields overlap or overflow a byte");
+static_assert(BATCH_COUNT_MASK == 0x1F && BATCH_BASE_RAIN == 0x20 && BATCH_RELAYED == 0x80,
+              "Byte 2 must be count [4:0], base rain [5], relayed [7]");
+static_assert(wirePut(BATCH_HDR_CURRENT_BITS, 0xF) == 0x0F && wirePut(BATCH_HDR_MOISTURE_BITS, 0xF) == 0xF0 &&
+              wirePut(BATCH_HDR_TIME_BITS, 0xF) == 0x0F,
+              "Bytes 10-11 must be current [3:0], moisture [7:4]; time [3:0]");
+static_assert(BATCH_MAX_READINGS <= BATCH_COUNT_MASK, "Batch count doesn't fit its field");
+static_assert(BATCH_CURRENT_BITS_MAX <= wireMax(BATCH_HDR_CURRENT_BITS) &&
+              BATCH_MOISTURE_BITS_MAX <= wireMax(BATCH_HDR_MOISTURE_BITS) &&
+              BATCH_TIME_BITS_MAX <= wireMax(BATCH_HDR_TIME_BITS),
+              "Batch delta widths don't fit their header fields");
+static_assert(BATCH_FRAME_MAX_LEN <= 255, "Batch frame must fit one LoRa packet");
+
+typedef struct {
+  uint32_t age_s;           // Seconds before the batch was sent
+  uint16_t current_cmA;     // 0.01 mA (0-40.95 mA)
+  uint8_t  moisture;        // 0.5 % (0-200)
+  uint8_t  flags;           // BATCH_READING_*
+} BatchReading;
+
+typedef struct {
+  uint8_t  sourceId;
+  uint8_t  sequence;
+  uint8_t  relayId;         // 0 if direct
+  int16_t  rssi;            // RSSI at relay (0 if direct)
+  uint16_t faultFlags;      // DIAG_* bits when sent
+  uint8_t  batteryPercent;  // Sender battery when sent
+  uint8_t  count;
+  BatchReading readings[BATCH_MAX_READINGS];   // Oldest first
+} SensorBatch;
+
+// Receive buffer big enough for every frame type. Check isBatchFrame()
+// first; anything else is handled as a SensorPacket-sized frame.
+typedef union {
+  SensorPacket sensor;
+  uint8_t      bytes[BATCH_FRAME_MAX_LEN];
+} RxFrame;
+
+inline uint32_t zigzagEncode(int32_t v) {
+  return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+inline int32_t zigzagDecode(uint32_t v) {
+  return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+// Bits needed to hold v
+inline uint8_t batchWidth(uint32_t v) {
+  uint8_t bits = 0;
+  while (v) {
+    bits++;
+    v >>= 1;
+  }
+  return bits;
+}
+
+typedef struct {
+  uint8_t* data;
+  uint16_t bit;
+} BatchBits;
+
+// Append bits LSB first (data must start zeroed)
+inline void batchPut(BatchBits* b, uint32_t v, uint8_t bits) {
+  for (uint8_t i = 0; i < bits; i++, b->bit++) {
+    if ((v >> i) & 1) b->data[b->bit / 8] |= 1 << (b->bit % 8);
+  }
+}
+
+inline uint32_t batchGet(BatchBits* b, uint8_t bits) {
+  uint32_t v = 0;
+  for (uint8_t i = 0; i < bits; i++, b->bit++) {
+    v |= (uint32_t)((b->data[b->bit / 8] >> (b->bit % 8)) & 1) << i;
+  }
+  return v;
+}
+
+inline int32_t batchClamp(int32_t v, int32_t lo, int32_t hi) {
+  return v < lo ? lo : v > hi ? hi : v;
+}
+
+static_assert(BATCH_HEADER_LEN + 2 > COMPACT_RELAY_FRAME_LEN,
+              "Version 3 has no msgType, so batch and compact frames must differ in length");
+
+inline bool isBatchFrame(const uint8_t* frame, size_t len) {
+  uint8_t version = frameVersion(frame);
+  return len >= BATCH_HEADER_LEN + 2 && len <= BATCH_FRAME_MAX_LEN &&
+         (version == 3 || (version == 2 && frameType(frame) == MSG_TYPE_BATCH));
+}
+
+// Encode a batch (frame must hold BATCH_FRAME_MAX_LEN bytes); relay fields
+// are appended when relayId is set. Returns the frame length.
+inline size_t encodeBatchFrame(const SensorBatch* batch, uint8_t* frame) {
+  uint8_t count = batch->count < 1 ? 1 :
+                  batch->count > BATCH_MAX_READINGS ? BATCH_MAX_READINGS : batch->count;
+  const BatchReading* r = batch->readings;
+  const int32_t timeMax = (1 << (BATCH_TIME_BITS_MAX - 1)) - 1;
+
+  // Differences from the reading before (on the clamped values the
+  // receiver rebuilds), and the widths that hold them all
+  uint32_t dTime[BATCH_MAX_READINGS] = {};
+  uint32_t dCurrent[BATCH_MAX_READINGS] = {};
+  uint32_t dMoisture[BATCH_MAX_READINGS] = {};
+  int32_t interval = count > 1 ? batchClamp((int32_t)(r[0].age_s - r[1].age_s), 0, 255) : 0;
+  uint8_t currentBits = 0, moistureBits = 0, timeBits = 0;
+  for (uint8_t i = 1; i < count; i++) {
+    int32_t step = (int32_t)(r[i - 1].age_s - r[i].age_s) - interval;
+    dTime[i] = zigzagEncode(batchClamp(step, -timeMax, timeMax));
+    dCurrent[i] = zigzagEncode(batchClamp(r[i].current_cmA, 0, COMPACT_CURRENT_MAX) -
+                               batchClamp(r[i - 1].current_cmA, 0, COMPACT_CURRENT_MAX));
+    dMoisture[i] = zigzagEncode(batchClamp(r[i].moisture, 0, 200) -
+                                batchClamp(r[i - 1].moisture, 0, 200));
+    if (batchWidth(dTime[i]) > timeBits) timeBits = batchWidth(dTime[i]);
+    if (batchWidth(dCurrent[i]) > currentBits) currentBits = batchWidth(dCurrent[i]);
+    if (batchWidth(dMoisture[i]) > moistureBits) moistureBits = batchWidth(dMoisture[i]);
+  }
+
+  uint32_t fields = packCompactFields(r[0].current_cmA, r[0].moisture,
+                                      batch->faultFlags, batch->batteryPercent);
+  uint32_t baseAge = r[0].age_s > 0xFFFF ? 0xFFFF : r[0].age_s;
+
+  memset(frame, 0, BATCH_FRAME_MAX_LEN);
+  frame[0] = frameHeaderV3(batch->sourceId);
+  frame[1] = batch->sequence;
+  frame[2] = wirePut(BATCH_HDR_COUNT, count) | wirePut(BATCH_HDR_RAIN, r[0].flags & BATCH_READING_RAIN ? 1 : 0);
+  for (uint8_t i = 0; i < 4; i++) {
+    frame[3 + i] = (uint8_t)(fields >> (8 * i));
+  }
+  frame[7] = (uint8_t)baseAge;
+  frame[8] = (uint8_t)(baseAge >> 8);
+  frame[9] = (uint8_t)interval;
+  frame[10] = wirePut(BATCH_HDR_CURRENT_BITS, currentBits) | wirePut(BATCH_HDR_MOISTURE_BITS, moistureBits);
+  frame[11] = wirePut(BATCH_HDR_TIME_BITS, timeBits);
+
+  BatchBits bits = { frame + BATCH_HEADER_LEN, 0 };
+  for (uint8_t i = 1; i < count; i++) {
+    batchPut(&bits, dTime[i], timeBits);
+    batchPut(&bits, dCurrent[i], currentBits);
+    batchPut(&bits, dMoisture[i], moistureBits);
+    batchPut(&bits, r[i].flags & BATCH_READING_RAIN ? 1 : 0, 1);
+  }
+
+  size_t len = BATCH_HEADER_LEN + (bits.bit + 7) / 8;
+  if (batch->relayId != 0) {
+    frame[2] |= BATCH_RELAYED;
+    frame[len++] = batch->relayId;
+    frame[len++] = (uint8_t)(int8_t)batchClamp(batch->rssi, -128, 127);
+  }
+  uint16_t crc = crc16(frame, len);
+  frame[len++] = (uint8_t)crc;
+  frame[len++] = (uint8_t)(crc >> 8);
+  return len;
+}
+
+// Check and decode a batch frame. Returns false on a bad CRC or layout.
+inline bool decodeBatchFrame(SensorBatch* batch, const uint8_t* frame, size_t len) {
+  if (!isBatchFrame(frame, len)) return false;
+  uint16_t crc = frame[len - 2] | (uint16_t)frame[len - 1] << 8;
+  if (crc != crc16(frame, len - 2)) return false;
+
+  uint8_t count = wireGet(BATCH_HDR_COUNT, frame[2]);
+  bool relayed = wireGet(BATCH_HDR_RELAYED, frame[2]);
+  uint8_t currentBits = wireGet(BATCH_HDR_CURRENT_BITS, frame[10]);
+  uint8_t moistureBits = wireGet(BATCH_HDR_MOISTURE_BITS, frame[10]);
+  uint8_t timeBits = wireGet(BATCH_HDR_TIME_BITS, frame[11]);
+  if (count < 1 || count > BATCH_MAX_READINGS || currentBits > BATCH_CURRENT_BITS_MAX ||
+      moistureBits > BATCH_MOISTURE_BITS_MAX) {
+    return false;
+  }
+  uint16_t deltaBits = (count - 1) * (timeBits + currentBits + moistureBits + 1);
+  if (len != BATCH_HEADER_LEN + (deltaBits + 7) / 8 + (relayed ? 2u : 0u) + 2) return false;
+
+  uint32_t fields = 0;
+  for (uint8_t i = 0; i < 4; i++) {
+    fields |= (uint32_t)frame[3 + i] << (8 * i);
+  }
+  uint32_t current, moisture, faults, battery;
+  unpackCompactFields(fields, &current, &moisture, &faults, &battery);
+
+  batch->sourceId = frameSource(frame);
+  batch->sequence = frame[1];
+  batch->faultFlags = faults;
+  batch->batteryPercent = battery;
+  batch->count = count;
+  batch->relayId = 0;
+  batch->rssi = 0;
+
+  BatchReading* r = batch->readings;
+  int32_t interval = frame[9];
+  r[0].age_s = frame[7] | (uint32_t)frame[8] << 8;
+  r[0].current_cmA = current;
+  r[0].moisture = moisture;
+  r[0].flags = wireGet(BATCH_HDR_RAIN, frame[2]) ? BATCH_READING_RAIN : 0;
+
+  BatchBits bits = { (uint8_t*)frame + BATCH_HEADER_LEN, 0 };
+  for (uint8_t i = 1; i < count; i++) {
+    int32_t step = zigzagDecode(batchGet(&bits, timeBits)) + interval;
+    int32_t age = (int32_t)r[i - 1].age_s - step;
+    r[i].age_s = age < 0 ? 0 : age;
+    r[i].current_cmA = batchClamp(r[i - 1].current_cmA + zigzagDecode(batchGet(&bits, currentBits)),
+                                  0, COMPACT_CURRENT_MAX);
+    r[i].moisture = batchClamp(r[i - 1].moisture + zigzagDecode(batchGet(&bits, moistureBits)), 0, 200);
+    r[i].flags = batchGet(&bits, 1) ? BATCH_READING_RAIN : 0;
+  }
+
+  if (relayed) {
+    batch->relayId = frame[len - 4];
+    batch->rssi = (int8_t)frame[len - 3];
+  }
+  return true;
+}
+
+// Mark a checked, direct batch frame as relayed: relayId and RSSI go in
+// before a fresh CRC (frame must hold BATCH_FRAME_MAX_LEN bytes). Returns
+// the new length, or 0 if it was already relayed.
+inline size_t appendBatchRelay(uint8_t* frame, size_t len, uint8_t relayId, int16_t rssi) {
+  if ((frame[2] & BATCH_RELAYED) || len + 2 > BATCH_FRAME_MAX_LEN) return 0;
+  len -= 2;
+  frame[2] |= BATCH_RELAYED;
+  frame[len++] = relayId;
+  frame[len++] = (uint8_t)(int8_t)batchClamp(rssi, -128, 127);
+  uint16_t crc = crc16(frame, len);
+  frame[len++] = (uint8_t)crc;
+  frame[len++] = (uint8_t)(crc >> 8);
+  return len;
+}
+
+// ===== Multi-Channel Packet =====
+// Sent CHANNEL_TX_DELAY_MS after the SensorPacket when the river unit has
+// more than one INA219. Same 16-byte size as SensorPacket, so relays and the
+// home unit receive both into the same buffer and dispatch on msgType.
+
+#define MAX_CURRENT_CHANNELS 4       // INA219 address straps 0x40/0x41/0x44/0x45
+
+typedef struct __attribute__((packed)) {
+  uint8_t  msgType;         // MSG_TYPE_CHANNELS
+  uint8_t  sourceId;        // Original sender ID (UNIT_ID_*)
+  uint8_t  relayId;         // Relay ID (0 if direct, UNIT_ID_RIDGE if relayed)
+  uint8_t  sequence;        // Sequence of the matching SensorPacket
+  uint8_t  channelCount;    // Channels in use (1-MAX_CURRENT_CHANNELS)
+  uint16_t current_cmA[MAX_CURRENT_CHANNELS];  // Current per channel, 0.01 mA (8 bytes)
+  int16_t  rssi;            // RSSI at relay (or 0 if direct) (2 bytes)
+  uint8_t  checksum;        // Simple checksum for validation
+} ChannelPacket;
+
+PACKET_SCHEMA(ChannelPacket, MSG_TYPE_CHANNELS, MSG_TYPE_CHANNELS);
+
+// ===== Storm Summary Packet =====
+// Storm mode captures a burst of STORM_SAMPLES loop-current readings at
+// STORM_SAMPLE_HZ and sends only this summary: statistics plus the signal
+// energy in STORM_BANDS frequency bands. Sent CHANNEL_TX_DELAY_MS after the
+// SensorPacket it belongs to (and before any ChannelPacket).
+
+#define STORM_SAMPLE_HZ     200      // Burst read rate (INA219 free-running at 532 us)
+#define STORM_SAMPLES       512      // Burst length, power of two (2.56 s)
+#define STORM_BANDS         4
+
+// Band edges in 0.1 Hz - band i covers [edge i, edge i+1)
+constexpr uint16_t STORM_BAND_EDGES_DHZ[STORM_BANDS + 1] = { 4, 10, 50, 200, 1000 };
+static const char* const STORM_BAND_NAMES[STORM_BANDS] = {
+  "surge", "waves", "turbulence", "noise"
+};
+
+typedef struct __attribute__((packed)) {
+  uint8_t  msgType;         // MSG_TYPE_STORM
+  uint8_t  sourceId;        // Original sender ID (UNIT_ID_*)
+  uint8_t  relayId;         // Relay ID (0 if direct, UNIT_ID_RIDGE if relayed)
+  uint8_t  sequence;        // Sequence of the matching SensorPacket
+  uint16_t mean_cmA;        // Burst mean, 0.01 mA (2 bytes)
+  uint8_t  sd_cmA;          // Standard deviation, 0.01 mA (saturates at 2.55 mA)
+  uint8_t  minBelow_5cmA;   // Mean - min, 0.05 mA (saturates)
+  uint8_t  maxAbove_5cmA;   // Max - mean, 0.05 mA (saturates)
+  uint8_t  bandDb[STORM_BANDS];  // Band energy, dB re 1 uA^2 (0 = none)
+  int16_t  rssi;            // RSSI at relay (or 0 if direct) (2 bytes)
+  uint8_t  checksum;        // Simple checksum for validation
+} StormPacket;
+
+PACKET_SCHEMA(StormPacket, MSG_TYPE_STORM, MSG_TYPE_STORM);
+
 #endif // LORA_CONFIG_H
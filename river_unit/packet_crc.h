@@ -0,0 +1,111 @@
+/*
+ * Packet CRC - Table-driven CRC-16 and CRC-32 for LoRa frames
+ *
+ * Included by lora_config.h. The copies in river_unit/, home_unit/ and
+ * ridge_relay/ must match this file (tdeck_relay includes it from the
+ * parent directory).
+ *
+ *   CRC-16/CCITT-FALSE  poly 0x1021, init 0xFFFF, no reflection, no xorout
+ *                       (check value 0x29B1). Protects the compact sensor
+ *                       frame from format version 2 on.
+ *   CRC-32/IEEE         reflected poly 0xEDB88320, init and xorout
+ *                       0xFFFFFFFF (check value 0xCBF43926, same as zlib).
+ *                       For longer frames; uses the ESP32 ROM routine when
+ *                       the core provides esp_rom_crc.h.
+ *
+ * Both 256-entry tables are generated at compile time, so they sit in flash
+ * with no start-up cost, and a byte costs one table lookup instead of eight
+ * shift/XOR steps. The XOR checksum it replaces misses any even number of
+ * flips in the same bit column and any reordering of bytes; a CRC-16
+ * catches every error burst up to 16 bits and all 1-3 bit errors in frames
+ * this short.
+ */
+
+#ifndef PACKET_CRC_H
+#define PACKET_CRC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#if __has_include("esp_rom_crc.h")
+  #include "esp_rom_crc.h"
+  #define PACKET_CRC32_ROM true
+#else
+  #define PACKET_CRC32_ROM false
+#endif
+
+#define CRC16_POLY      0x1021
+#define CRC16_INIT      0xFFFF
+#define CRC32_POLY      0xEDB88320UL   // Reflected 0x04C11DB7
+#define CRC32_INIT      0xFFFFFFFFUL
+
+typedef struct {
+  uint16_t v[256];
+} Crc16Table;
+
+typedef struct {
+  uint32_t v[256];
+} Crc32Table;
+
+constexpr Crc16Table crc16MakeTable() {
+  Crc16Table t = {};
+  for (uint16_t i = 0; i < 256; i++) {
+    uint16_t crc = i << 8;
+    for (uint8_t b = 0; b < 8; b++) {
+      crc = crc & 0x8000 ? (uint16_t)(crc << 1) ^ CRC16_POLY : (uint16_t)(crc << 1);
+    }
+    t.v[i] = crc;
+  }
+  return t;
+}
+
+constexpr Crc32Table crc32MakeTable() {
+  Crc32Table t = {};
+  for (uint16_t i = 0; i < 256; i++) {
+    uint32_t crc = i;
+    for (uint8_t b = 0; b < 8; b++) {
+      crc = crc & 1 ? (crc >> 1) ^ CRC32_POLY : crc >> 1;
+    }
+    t.v[i] = crc;
+  }
+  return t;
+}
+
+constexpr Crc16Table CRC16_TABLE = crc16MakeTable();
+constexpr Crc32Table CRC32_TABLE = crc32MakeTable();
+
+// Continue a CRC-16 over more bytes (start with CRC16_INIT)
+constexpr uint16_t crc16Update(uint16_t crc, const uint8_t* data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    crc = (uint16_t)(crc << 8) ^ CRC16_TABLE.v[(uint8_t)(crc >> 8) ^ data[i]];
+  }
+  return crc;
+}
+
+// Continue a CRC-32 over more bytes (start with CRC32_INIT, finish with ~)
+constexpr uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    crc = (crc >> 8) ^ CRC32_TABLE.v[(uint8_t)crc ^ data[i]];
+  }
+  return crc;
+}
+
+constexpr uint16_t crc16(const uint8_t* data, size_t len) {
+  return crc16Update(CRC16_INIT, data, len);
+}
+
+inline uint32_t crc32(const uint8_t* data, size_t len) {
+  #if PACKET_CRC32_ROM
+    // ROM routine inverts on entry and exit (zlib convention)
+    return esp_rom_crc32_le(0, data, len);
+  #else
+    return ~crc32Update(CRC32_INIT, data, len);
+  #endif
+}
+
+// Standard check values over "123456789"
+constexpr uint8_t CRC_CHECK_INPUT[9] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+static_assert(crc16(CRC_CHECK_INPUT, 9) == 0x29B1, "CRC-16/CCITT-FALSE table is wrong");
+static_assert(~crc32Update(CRC32_INIT, CRC_CHECK_INPUT, 9) == 0xCBF43926UL, "CRC-32 table is wrong");
+
+#endif // PACKET_CRC_H
@@ -7,14 +7,18 @@
  *
  * Hardware:
  * - ALS-MPM-2F Hydrostatic Sensor (4-20 mA output) - optional
- * - INA219 Current Sensor Module
+ * - INA219 Current Sensor Module (up to 4, one per gauge)
  * - LM393 Soil Moisture Sensor
  * - Heltec WiFi LoRa 32 V3 (built-in OLED and LoRa)
  * - 19.5V Dell Power Supply (for hydrostatic sensor)
+ * - LiPo cell on the Heltec battery connector (optional, BATTERY_GAUGE)
  *
  * Connections:
- * - INA219: SDA=GPIO1, SCL=GPIO2 (separate I2C bus)
- * - LM393: AO=GPIO4
+ * - INA219: SDA=GPIO1 (GPIO7 with BATTERY_GAUGE), SCL=GPIO2
+ *   (separate I2C bus, 400 kHz)
+ *   Extra INA219s share the bus at 0x41, 0x44 and 0x45 (A0/A1 straps)
+ * - LM393: AO=GPIO4, DO=GPIO5 (rain onset interrupt/wake),
+ *          VCC=GPIO6 with MOISTURE_POWER_GATING (else 3V3)
  * - Built-in OLED: SDA=GPIO17, SCL=GPIO18 (internal)
  * - LoRa SX1262: Uses internal SPI (GPIO 8,9,10,11,12,13,14)
  */
@@ -25,18 +29,276 @@
 #include <Adafruit_SSD1306.h>
 #include <RadioLib.h>
 #include "lora_config.h"
+#include "sensor_filter.h"
+#include "depth_calibration.h"
+#include "battery_gauge.h"
+#include "sensor_diag.h"
+#include "driver/gpio.h"
+#include "driver/rtc_io.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include <sys/time.h>
+#include "sdkconfig.h"
 
 // Board version - River unit uses V3
 #define HELTEC_V3
 
+// ===== NODE ID =====
+// sourceId of every packet this unit sends. Each sensor node on the channel
+// needs its own ID; the home unit keeps a table entry per ID (node_table.h).
+// Compact and batch frames carry IDs up to COMPACT_SOURCE_ID_MAX (63) only.
+#define NODE_ID UNIT_ID_RIVER
+
+static_assert(isSensorSource(NODE_ID), "NODE_ID is taken by a relay or the home unit");
+
+// ===== BATTERY GAUGE =====
+// true  = running from a LiPo on the board's battery connector: VBAT is read
+//         through the on-board divider (GPIO1, switched by GPIO37) and sent
+//         as a real state of charge. GPIO1 is then the divider tap, so the
+//         INA219 bus moves to SDA=GPIO7.
+// false = mains powered, batteryPercent is sent as 100
+#define BATTERY_GAUGE false
+
 // Pin definitions for V3
 #define OLED_SDA 17
 #define OLED_SCL 18
 #define OLED_RST 21
 #define VEXT_CTRL 36  // Vext power control for OLED
-#define INA219_SDA 1
+#if BATTERY_GAUGE
+  #define INA219_SDA 7        // GPIO1 is the VBAT divider tap
+#else
+  #define INA219_SDA 1
+#endif
 #define INA219_SCL 2
 #define MOISTURE_SENSOR_PIN 4
+#define RAIN_DO_PIN 5         // LM393 DO - LOW once the threshold pot trips (wet)
+#define MOISTURE_POWER_PIN 6  // LM393 VCC when MOISTURE_POWER_GATING is enabled
+#define VBAT_ADC_PIN 1        // VBAT / 4.9 (390k + 100k divider)
+#define VBAT_CTRL_PIN 37      // Divider switch (ADC_Ctrl)
+#define VBAT_CTRL_ON LOW      // V3.0 boards; V3.1 boards switch the divider on HIGH
+
+// ===== BOOT =====
+// Start-up is overlapped instead of waiting on fixed delays: the OLED powers
+// up in reset while the INA219s and moisture probe take the first reading
+// and the radio initialises, so the first packet goes out as soon as both
+// are ready. Deep-sleep wakes that are known to transmit bring the radio up
+// while the first conversion runs.
+// true  = show the LoRa status splash for BOOT_SPLASH_MS before measuring
+#define BOOT_SPLASH false
+
+const unsigned long BOOT_SPLASH_MS = 2000;
+const unsigned long SERIAL_WAIT_MS = 1000;      // Max wait for a USB CDC host (UART is ready at once)
+const unsigned long OLED_POWER_UP_MS = 100;     // Vext on to first OLED command
+
+// ===== INA219 ACQUISITION MODE =====
+// true  = program the INA219's on-chip averaging and read one triggered
+//         128-sample conversion per reading (one I2C result read)
+// false = software average of SAMPLE_COUNT separate register reads
+#define INA219_HW_AVERAGING true
+
+// INA219 channels - probed at boot, channel 0 is the first one found and
+// feeds the main SensorPacket, display and calibration commands
+#define INA219_I2C_CLOCK_HZ  400000   // Fast mode (INA219 max without HS master code)
+const uint8_t INA219_CHANNEL_ADDRS[MAX_CURRENT_CHANNELS] = { 0x40, 0x41, 0x44, 0x45 };
+
+// INA219 registers used for triggered conversions
+#define INA219_REG_CFG       0x00
+#define INA219_REG_SHUNT     0x01
+#define INA219_REG_BUS       0x02
+#define INA219_BUS_CNVR      0x0002   // Conversion ready bit in bus voltage register
+
+// 32V range, /8 gain (320 mV), 9-bit bus ADC, 128-sample shunt average,
+// shunt + bus triggered mode. Writing this value starts one conversion.
+#define INA219_CFG_TRIGGER_128S  0x387B
+#define INA219_CFG_POWER_DOWN    0x3878   // Same settings, power-down mode (deep sleep)
+#define INA219_CFG_CONTINUOUS_128S 0x387F // Same settings, continuous (battery monitor)
+
+// ===== MOISTURE ACQUISITION MODE =====
+// true  = one continuous (DMA) ADC frame of MOISTURE_DMA_CONVERSIONS samples,
+//         averaged by the ADC driver and collected when the frame completes
+// false = MOISTURE_SAMPLE_COUNT analogRead() samples spaced 10 ms apart
+#define MOISTURE_DMA_ADC true
+
+// ===== RAIN ONSET =====
+// true  = a falling edge on the LM393 DO pin starts an immediate reading and
+//         transmission outside the TX_INTERVAL_MS schedule
+#define RAIN_ONSET_ENABLED true
+
+// true  = light sleep between cycles, woken by the cycle timer or by DO.
+//         USB serial (and CAL commands) drop out while asleep - leave false
+//         while calibrating or debugging
+#define RIVER_LIGHT_SLEEP false
+
+// ===== DEEP SLEEP MODE =====
+// true  = battery/solar operation: deep sleep between readings, sample every
+//         SLEEP_SAMPLE_INTERVAL_SEC into an RTC ring buffer and power the
+//         radio only when the reporting policy (below) or a rain onset
+//         calls for a transmit.
+//         OLED stays off and serial CAL commands are unavailable.
+// false = stay awake, sample every TX_INTERVAL_MS (bench / mains power)
+#define RIVER_DEEP_SLEEP false
+
+#if RIVER_DEEP_SLEEP && RIVER_LIGHT_SLEEP
+  #error "Choose one of RIVER_DEEP_SLEEP and RIVER_LIGHT_SLEEP"
+#endif
+
+// ===== ULP MOISTURE SAMPLING =====
+// true  = (RIVER_DEEP_SLEEP only) the ULP coprocessor samples the moisture
+//         ADC every MOISTURE_ULP_PERIOD_MS while the main cores sleep, keeps
+//         min/max/mean in RTC memory, and wakes the CPU only to transmit:
+//         wet threshold crossed, moisture moved by MOISTURE_ULP_DELTA_RAW,
+//         or a scheduled report is due
+// false = the main CPU wakes every SLEEP_SAMPLE_INTERVAL_SEC to sample
+#define MOISTURE_ULP false
+
+#if MOISTURE_ULP
+  #if !RIVER_DEEP_SLEEP
+    #error "MOISTURE_ULP needs RIVER_DEEP_SLEEP"
+  #endif
+  #if !CONFIG_ULP_COPROC_ENABLED || !CONFIG_ULP_COPROC_TYPE_FSM
+    #error "MOISTURE_ULP needs the ULP FSM coprocessor enabled in the core's sdkconfig"
+  #endif
+  #include "ulp.h"
+  #include "ulp_adc.h"
+#endif
+
+// ===== MOISTURE PROBE POWER =====
+// true  = LM393 VCC is driven from MOISTURE_POWER_PIN and only switched on
+//         for each sampling window (less idle current, less probe corrosion)
+// false = LM393 VCC on 3V3 full time
+// Can't be combined with RAIN_ONSET_ENABLED: DO only sees rain while the
+// probe is powered
+#define MOISTURE_POWER_GATING false
+
+#if MOISTURE_POWER_GATING && RAIN_ONSET_ENABLED
+  #error "MOISTURE_POWER_GATING needs RAIN_ONSET_ENABLED false (DO is dead while the probe is off)"
+#endif
+
+#if MOISTURE_ULP && MOISTURE_POWER_GATING
+  #error "MOISTURE_ULP can't switch the probe supply - set MOISTURE_POWER_GATING false"
+#endif
+
+#if BATTERY_GAUGE && MOISTURE_ULP
+  #error "BATTERY_GAUGE reads VBAT on ADC1, which the ULP owns through deep sleep - set MOISTURE_ULP false"
+#endif
+
+// Battery gauge settings (BATTERY_GAUGE)
+// VBAT is read with the core's eFuse-calibrated analogReadMilliVolts();
+// VBAT_CAL_SCALE trims the divider tolerance against a multimeter.
+const float VBAT_DIVIDER = 4.9;
+const float VBAT_CAL_SCALE = 1.0;                // Multimeter VBAT / reported VBAT
+const uint8_t VBAT_SAMPLE_COUNT = 16;
+const uint16_t BATTERY_CAPACITY_MAH = 3000;
+const uint16_t BATTERY_INTERNAL_MOHM = 150;      // Cell + connector + protection FET
+const uint8_t BATTERY_LOW_PERCENT = 20;          // Below this, report less often
+
+// Load model used for IR compensation and charge counting when there is
+// no battery INA219 - measure your board and adjust
+const float BATTERY_AWAKE_MA = 45.0;             // CPU + OLED + radio standby
+const float BATTERY_TX_MA = 120.0;               // Added while the SX1262 transmits
+const float BATTERY_SLEEP_MA = 0.05;             // Deep sleep (RIVER_DEEP_SLEEP)
+
+// Optional INA219 in the battery lead for measured (not modelled) draw.
+// 0 = none. Strap it to an address outside INA219_CHANNEL_ADDRS, e.g. 0x4A.
+#define BATTERY_INA219_ADDR  0x00
+const float BATTERY_SHUNT_OHMS = 0.1;            // 10 uV shunt LSB -> 0.1 mA
+
+static_assert(BATTERY_INA219_ADDR == 0x00 ||
+              (BATTERY_INA219_ADDR != 0x40 && BATTERY_INA219_ADDR != 0x41 &&
+               BATTERY_INA219_ADDR != 0x44 && BATTERY_INA219_ADDR != 0x45),
+              "BATTERY_INA219_ADDR collides with a gauge channel address");
+
+// Gauge state (RTC memory so the charge count survives deep sleep)
+RTC_DATA_ATTR BatteryGauge batteryGauge;
+RTC_DATA_ATTR int64_t batteryLastUs = 0;         // rtcTimeUs() at the last update
+RTC_DATA_ATTR uint32_t batteryAirtimeMs = 0;     // TX airtime since the last update
+RTC_DATA_ATTR uint32_t batteryAwakeMs = 0;       // Awake time on earlier wakes since the last update
+uint32_t batteryMarkMs = 0;                      // millis() at the last update (this wake)
+bool batteryMonitorAvailable = false;            // Battery INA219 found
+uint8_t batteryLevel = 100;                      // Sent in SensorPacket
+bool batteryLow = false;
+
+// ===== BATCHED UPLINK =====
+// true  = every reading is queued in the RTC ring and sent BATCH_READINGS at
+//         a time in one delta-packed batch frame (lora_config.h) instead of
+//         the reporting policy choosing single readings. A report the policy
+//         asks for (rain onset, fault, deadband, heartbeat) sends the queue
+//         at once, so events are not held back; steady readings wait up to
+//         BATCH_READINGS cycles. The home unit gets every reading at a
+//         fraction of the airtime each.
+// false = one SensorPacket per report, readings in between are not sent
+#define BATCH_UPLINK false
+
+// Readings per batch: latency (x TX_INTERVAL_MS, or SLEEP_SAMPLE_INTERVAL_SEC
+// in deep sleep) against airtime. 6 readings take ~200 ms on air, 16 ~230 ms.
+#define BATCH_READINGS 6
+
+static_assert(BATCH_READINGS >= 1 && BATCH_READINGS <= BATCH_MAX_READINGS,
+              "BATCH_READINGS must be 1..BATCH_MAX_READINGS");
+static_assert(NODE_ID <= COMPACT_SOURCE_ID_MAX || (!SENSOR_PACKET_COMPACT && !BATCH_UPLINK),
+              "NODE_ID above 63 needs SENSOR_PACKET_COMPACT and BATCH_UPLINK false");
+
+// ===== STORM MODE =====
+// true  = on rain onset or a flood-rate rise, capture a burst of
+//         STORM_SAMPLES channel-0 readings at STORM_SAMPLE_HZ with the INA219
+//         free-running at its fastest 12-bit conversion, and send a compact
+//         StormPacket (mean/SD/min/max + band energies) after the next
+//         SensorPacket instead of the raw samples
+// false = no bursts; only the normal sensor readings are sent
+// The burst keeps the CPU awake for ~2.6 s, so to enable it set this true
+// on an awake unit (RIVER_DEEP_SLEEP false) with LORA_IMPLICIT_HEADER false
+// in lora_config.h, and check the home unit prints the storm summaries
+#define STORM_MODE_ENABLED false
+
+#if STORM_MODE_ENABLED && RIVER_DEEP_SLEEP
+  #error "STORM_MODE_ENABLED needs RIVER_DEEP_SLEEP false"
+#endif
+
+#if LORA_IMPLICIT_HEADER && (STORM_MODE_ENABLED || BATCH_UPLINK)
+  #error "LORA_IMPLICIT_HEADER sends fixed-length sensor frames only - set STORM_MODE_ENABLED and BATCH_UPLINK false"
+#endif
+
+// Statistics and FFT use ESP-DSP (ESP32-S3 SIMD kernels) when the core
+// ships it, plain loops otherwise
+#if __has_include("esp_dsp.h")
+  #include "esp_dsp.h"
+  #define STORM_USE_ESP_DSP true
+#else
+  #define STORM_USE_ESP_DSP false
+#endif
+
+// 12-bit single shunt conversions (532 us), shunt continuous - the burst
+// reads whatever conversion finished last
+#define INA219_CFG_STORM          0x381D
+
+const unsigned long STORM_HOLDOFF_MS = 60000;    // At most one burst per minute
+const float STORM_RATE_MM_MIN = 5.0;             // Flood-rate trigger (same as REPORT_FLOOD_RATE_MM_MIN)
+const float STORM_HANN_POWER = 0.375;            // Mean of the Hann window squared
+const uint16_t STORM_MAX_READ_ERRORS = STORM_SAMPLES / 16;  // Abort a burst after more failed reads
+
+static_assert((STORM_SAMPLES & (STORM_SAMPLES - 1)) == 0, "STORM_SAMPLES must be a power of two");
+static_assert(STORM_SAMPLE_HZ * 10 / 2 >= STORM_BAND_EDGES_DHZ[STORM_BANDS],
+              "Top storm band is above the burst Nyquist frequency");
+
+// Burst state - the esp_timer task fills stormSamples, loop() does the maths
+esp_timer_handle_t stormTimer = NULL;
+int16_t stormSamples[STORM_SAMPLES];             // Raw shunt register values
+volatile uint16_t stormCount = 0;
+volatile uint16_t stormReadErrors = 0;           // Failed reads skipped this burst
+volatile bool stormDone = false;                 // Burst full, or aborted if stormCount is short
+bool stormCapturing = false;
+bool stormTrigger = false;                       // Rain onset seen - burst after this cycle
+unsigned long lastStormTime = 0;
+bool stormRan = false;                           // A burst has run since boot
+float stormBuffer[STORM_SAMPLES * 2];            // Interleaved complex FFT work area
+float stormWindow[STORM_SAMPLES];                // Hann window
+
+// Finished summary, sent after the next SensorPacket
+StormPacket stormPkt;
+bool stormReady = false;
+bool stormTxPending = false;
+unsigned long stormTxTime = 0;
 
 // OLED display parameters
 #define SCREEN_WIDTH 128
@@ -47,7 +309,10 @@
 TwoWire I2C_INA219 = TwoWire(1);
 
 // Create device instances
-Adafruit_INA219 ina219;
+Adafruit_INA219 ina219Devices[MAX_CURRENT_CHANNELS] = {
+  Adafruit_INA219(INA219_CHANNEL_ADDRS[0]), Adafruit_INA219(INA219_CHANNEL_ADDRS[1]),
+  Adafruit_INA219(INA219_CHANNEL_ADDRS[2]), Adafruit_INA219(INA219_CHANNEL_ADDRS[3])
+};
 Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RST);
 
 // LoRa radio instance
@@ -57,116 +322,897 @@ SX1262 radio = new Module(LORA_NSS, LORA_DIO1, LORA_RST, LORA_BUSY, loraSPI);
 // Flag to track if INA219 is available
 bool ina219Available = false;
 
+// INA219 channels found at boot, in address order
+Adafruit_INA219* channelSensor[MAX_CURRENT_CHANNELS];
+uint8_t channelAddr[MAX_CURRENT_CHANNELS];
+uint8_t channelCount = 0;
+
 // LoRa status
 bool loraInitialized = false;
-uint8_t packetSequence = 0;
+RTC_DATA_ATTR uint8_t packetSequence = 0;     // Continues across deep sleep
+bool displayReady = false;                    // OLED initialized this boot
+
+// Asynchronous transmit: startTransmit() returns at once and DIO1 signals
+// TX done, so sampling, logging and the OLED keep running during airtime
+const unsigned long TX_TIMEOUT_MS = 2000;     // Well above the ~200 ms airtime
+volatile bool txDoneFlag = false;             // Set by the DIO1 ISR
+bool txBusy = false;                          // Packet on air
+uint8_t txMsgType = 0;                        // msgType of the packet on air
+uint8_t txSequence = 0;
+unsigned long txStartTime = 0;
+bool loraTxOk = false;                        // Result of the last SensorPacket
+uint8_t txRingHead = 0;                       // Ring slot after the last reading the packet on air delivers
+uint8_t txRingCount = 0;                      // Stored readings it delivers
+bool cycleRainOnset = false;                  // This awake cycle was started by rain onset
 
 // Sensor calibration parameters
+// Depth comes from the depth_calibration.h table; these bound the fault warnings
 const float MIN_CURRENT_MA = 4.0;
 const float MAX_CURRENT_MA = 20.0;
-const float MAX_DEPTH_CM = 100.0;
 const float CM_TO_INCHES = 0.393701;
 
+// Active depth calibration (compile-time default or loaded from NVS)
+CalTable depthCal;
+
 // Measurement settings
 const int SAMPLE_COUNT = 10;
 const unsigned long SAMPLE_DELAY_MS = 100;
 
+// Hardware averaging settings (INA219_HW_AVERAGING)
+const int32_t INA219_SHUNT_UA_PER_LSB = 100;          // 10 uV LSB across the 0.1 ohm shunt
+const unsigned long INA219_CONVERSION_MS = 69;        // 128 x 532 us shunt conversions
+const unsigned long INA219_READY_POLL_MS = 2;         // Conversion-ready poll spacing
+const unsigned long INA219_CONVERSION_TIMEOUT_MS = 250;
+
+// Current filter (sensor_filter.h): median spike rejection + EWMA
+#if INA219_HW_AVERAGING
+const uint8_t CURRENT_FILTER_SHIFT = 1;   // One averaged sample per cycle
+#else
+const uint8_t CURRENT_FILTER_SHIFT = 2;   // SAMPLE_COUNT samples per cycle
+#endif
+
 // Soil moisture sensor settings
 const int MOISTURE_DRY_VALUE = 4095;
 const int MOISTURE_WET_VALUE = 1500;
 const int MOISTURE_SAMPLE_COUNT = 5;
+const unsigned long MOISTURE_SAMPLE_DELAY_MS = 10;
 const unsigned long MOISTURE_READ_INTERVAL_MS = 10000;
+const uint32_t MOISTURE_DMA_CONVERSIONS = 256;         // Samples decimated into one reading
+const uint32_t MOISTURE_DMA_SAMPLE_HZ = 20000;          // 256 samples in ~13 ms
+const unsigned long MOISTURE_DMA_TIMEOUT_MS = 200;      // Give up on a frame after this
+const unsigned long MOISTURE_SETTLE_MS = 100;          // Probe power-on to first sample
+
+// Multi-channel uplink: ChannelPacket follows the SensorPacket
+bool channelTxPending = false;
+unsigned long channelTxTime = 0;
+uint8_t channelTxSequence = 0;
+
+// Rain onset settings
+const unsigned long RAIN_ONSET_HOLDOFF_MS = 60000;      // Ignore DO chatter after an onset report
+const unsigned long LIGHT_SLEEP_MIN_MS = 20;            // Don't sleep for shorter idle gaps
+
+// Rain onset state
+volatile bool rainOnsetFlag = false;     // Set by the DO falling-edge ISR
+unsigned long lastRainOnsetTime = 0;
+bool rainOnsetReported = false;          // An onset has been reported since boot
 
 // Moisture timing
 unsigned long lastMoistureReadTime = 0;
 int lastMoistureRaw = 0;
 float lastMoisturePercent = 0.0;
 
+// ===== REPORTING POLICY =====
+// Report by exception: a reading is only transmitted when it has moved
+// outside a deadband since the last report, or when the silence limit for
+// the current rate of change runs out:
+//   flood  (|rate| >= REPORT_FLOOD_RATE_MM_MIN)  - sample + report every 5 s
+//   active (|rate| >= REPORT_ACTIVE_RATE_MM_MIN) - at least every minute
+//   calm                                         - REPORT_HEARTBEAT_MS
+const int32_t REPORT_DEPTH_DEADBAND_MM = 20;          // 2 cm
+const float REPORT_MOISTURE_DEADBAND = 5.0;           // Percentage points
+const float REPORT_FLOOD_RATE_MM_MIN = 5.0;           // ~30 cm/hour
+const float REPORT_ACTIVE_RATE_MM_MIN = 1.0;          // ~6 cm/hour
+const unsigned long REPORT_FAST_INTERVAL_MS = TX_INTERVAL_MS / 2;
+const unsigned long REPORT_ACTIVE_INTERVAL_MS = 60000;
+const uint8_t REPORT_RATE_SHIFT = 2;                  // Rate EWMA alpha = 1/4
+
+static_assert(TX_INTERVAL_MS % REPORT_FAST_INTERVAL_MS == 0,
+              "Fast report slots must stay on the TX_INTERVAL_MS grid");
+
+// Policy state (RTC memory so it carries across deep sleep)
+RTC_DATA_ATTR bool reportPrimed = false;         // At least one report sent
+RTC_DATA_ATTR int32_t lastReportDepthMm = 0;
+RTC_DATA_ATTR float lastReportMoisture = 0;
+RTC_DATA_ATTR uint32_t lastReportTimeMs = 0;     // RTC clock (rtcTimeUs / 1000)
+RTC_DATA_ATTR bool ratePrimed = false;
+RTC_DATA_ATTR int32_t rateDepthMm = 0;           // Depth at the previous reading
+RTC_DATA_ATTR uint32_t rateTimeMs = 0;
+RTC_DATA_ATTR float depthRateMmMin = 0;          // Smoothed rate of change (mm/min)
+bool forceReport = false;                        // Rain onset: send regardless
+
 // Transmission timing
-unsigned long lastTxTime = 0;
+// An esp_timer fires TX_SAMPLE_LEAD_MS before each TX slot so the samplers
+// finish in time; the packet goes out on the slot boundary itself. Slots are
+// counted from a fixed base, so the period never drifts with workload.
+#if INA219_HW_AVERAGING
+const unsigned long CURRENT_SAMPLE_TIME_MS = 100;       // One triggered conversion + polling
+#else
+const unsigned long CURRENT_SAMPLE_TIME_MS = 1000;      // SAMPLE_COUNT x SAMPLE_DELAY_MS
+#endif
+const unsigned long MOISTURE_SAMPLE_TIME_MS = 300;      // Settle + DMA frame (or analogRead)
+const unsigned long TX_SAMPLE_LEAD_MS =
+  (CURRENT_SAMPLE_TIME_MS > MOISTURE_SAMPLE_TIME_MS ? CURRENT_SAMPLE_TIME_MS : MOISTURE_SAMPLE_TIME_MS) + 50;
+
+esp_timer_handle_t slotTimer = NULL;
+portMUX_TYPE slotMux = portMUX_INITIALIZER_UNLOCKED;
+int64_t slotOriginUs = 0;           // First slot; every slot is on a slotIntervalMs grid from here
+int64_t slotBaseUs = 0;             // Unjittered start of the current slot (timer task only)
+int64_t slotJitterUs = 0;           // Jitter the current slot was armed with (timer task only)
+volatile bool slotDue = false;      // Timer fired - start sampling for pendingTxUs
+volatile int64_t pendingTxUs = 0;   // Transmit time for the slot that just fired
+int64_t cycleTxUs = 0;              // Transmit time of the running cycle (0 = send when sampled)
+bool cyclePending = false;          // Samplers running, report not sent yet
+uint32_t slotOverruns = 0;          // Slots that fired while the previous one was still pending
+
+volatile uint32_t slotIntervalMs = TX_INTERVAL_MS;   // Shortened during a flood
+
+static_assert(TX_SLOT_JITTER_MS + TX_SAMPLE_LEAD_MS < REPORT_FAST_INTERVAL_MS,
+              "TX slot jitter + sample lead must fit inside the fastest slot");
+
+// Non-blocking sampler state
+// loop() never waits on the sensors: each pass takes at most one reading
+// per channel, and finished averages are published for reportReading()
+bool currentSampling = false;
+int currentSampleIndex = 0;
+RTC_DATA_ATTR SensorFilter currentFilter[MAX_CURRENT_CHANNELS];  // Loop current in uA (kept across deep sleep)
+uint8_t currentPendingMask = 0;      // Channels still converting (HW averaging)
+unsigned long nextCurrentSampleTime = 0;
+unsigned long currentCycleStart = 0;
+float lastChannelCurrent[MAX_CURRENT_CHANNELS];
+float lastCurrent = 0.0;             // Channel 0
+float lastRawCurrent = 0.0;          // Channel 0, last sample before the filter (diagnostics)
+
+// Self-diagnostics (sensor_diag.h) - fault bits go out in every SensorPacket
+RTC_DATA_ATTR SensorDiag sensorDiag;
+RTC_DATA_ATTR uint16_t lastReportFaults = 0;
+uint16_t diagFaults = 0;
+
+bool moistureSampling = false;
+int moistureSampleIndex = 0;
+long moistureTotal = 0;
+unsigned long nextMoistureSampleTime = 0;
+unsigned long moistureCycleStart = 0;
+bool moistureDmaActive = false;               // Continuous ADC frame in progress
+volatile bool moistureFrameReady = false;     // Set by ADC driver when frame is done
+bool moistureSettling = false;                // Probe powered, waiting MOISTURE_SETTLE_MS
+
+// Deep sleep settings (RIVER_DEEP_SLEEP)
+#define uS_TO_S_FACTOR 1000000ULL
+#define SLEEP_RING_SIZE 32                       // Readings kept in RTC memory
+const uint32_t SLEEP_SAMPLE_INTERVAL_SEC = 60;   // Wake and sample this often
+const unsigned long SLEEP_TX_WAIT_MS = 3000;     // Max time awake for TX + ChannelPacket
+
+// One stored reading (8 bytes)
+typedef struct {
+  uint32_t time;            // Seconds since power-on (RTC clock)
+  uint16_t current_cmA;     // Channel 0 current, 0.01 mA
+  uint8_t  moisture;        // 0.5 %
+  uint8_t  flags;           // SLEEP_READING_*
+} SleepReading;
+
+#define SLEEP_READING_RAIN  0x01   // Taken on a rain-onset wake
+#define SLEEP_READING_SENT  0x02   // Included in a successful transmit
+
+// RTC memory - survives deep sleep. With BATCH_UPLINK the awake mode queues
+// its readings here too.
+RTC_DATA_ATTR SleepReading sleepRing[SLEEP_RING_SIZE];
+RTC_DATA_ATTR uint8_t sleepRingHead = 0;         // Next slot to write
+RTC_DATA_ATTR uint8_t sleepRingCount = 0;
+RTC_DATA_ATTR uint8_t readingsSinceTx = 0;       // Stored since the last delivered packet
+RTC_DATA_ATTR int64_t sleepNextWakeUs = 0;       // Absolute RTC time of the next wake
+RTC_DATA_ATTR uint32_t sleepWakeCount = 0;
+
+// True when this boot is a deep-sleep wake rather than power-on/reset
+bool warmWake = false;
+
+// Boot timing (millis() restarts on every boot and deep-sleep wake)
+unsigned long setupDoneMs = 0;
+bool bootPacketLogged = false;
+
+// ULP moisture settings (MOISTURE_ULP)
+#define MOISTURE_ADC_CHANNEL   3          // GPIO4 = ADC1 channel 3 on the ESP32-S3
+const uint32_t MOISTURE_ULP_PERIOD_MS = 4000;     // ULP sample interval
+const uint16_t MOISTURE_ULP_WET_RAW = 3000;       // Wake when raw drops below (wet)
+const uint16_t MOISTURE_ULP_DELTA_RAW = 300;      // Wake on this change since last report
+const uint16_t MOISTURE_ULP_REPORT_SAMPLES =      // Scheduled report after this many samples
+  REPORT_HEARTBEAT_MS / MOISTURE_ULP_PERIOD_MS;
+
+// Mean is kept as a sum of (raw >> 4) in a 16-bit ULP register
+static_assert(MOISTURE_ULP_REPORT_SAMPLES >= 1 && MOISTURE_ULP_REPORT_SAMPLES <= 257,
+              "ULP report interval overflows the 16-bit moisture sum");
+
+// ULP data words at the start of RTC slow memory (low 16 bits are data),
+// program loaded after them
+enum {
+  ULP_COUNT = 0,      // Samples since last report
+  ULP_MIN,            // Lowest raw sample (wettest)
+  ULP_MAX,            // Highest raw sample (driest)
+  ULP_SUM,            // Sum of (raw >> 4)
+  ULP_LAST,           // Latest raw sample
+  ULP_BASELINE,       // Raw value at the last report
+  ULP_DELTA,          // MOISTURE_ULP_DELTA_RAW
+  ULP_WET,            // Wet threshold (0 = disarmed while already wet)
+  ULP_LIMIT,          // MOISTURE_ULP_REPORT_SAMPLES
+  ULP_REASON,         // Why the ULP woke the CPU (ULP_WAKE_*)
+  ULP_DATA_WORDS = 16
+};
+
+#define ULP_WAKE_REPORT 1
+#define ULP_WAKE_WET    2
+#define ULP_WAKE_DELTA  3
+
+// Continuous ADC frame complete (called from the ADC driver)
+void ARDUINO_ISR_ATTR onMoistureFrame() {
+  moistureFrameReady = true;
+}
+
+// LM393 DO went low - soil/rain sensor crossed the wet threshold
+void ARDUINO_ISR_ATTR onRainOnset() {
+  rainOnsetFlag = true;
+}
+
+// Slot timer (esp_timer task): hand the slot to loop() and arm the next one
+void onSlotTimer(void* arg) {
+  // Same jitter the timer was armed with, so TX is exactly one sample lead
+  // after this callback
+  int64_t txUs = slotBaseUs + slotJitterUs;
+
+  portENTER_CRITICAL(&slotMux);
+  if (slotDue) slotOverruns++;
+  pendingTxUs = txUs;
+  slotDue = true;
+  portEXIT_CRITICAL(&slotMux);
+
+  // Next slot on the current interval's grid from the fixed origin, so a
+  // switch between the normal and flood interval lands back on the new
+  // grid; skip any slots already in the past
+  int64_t nowUs = esp_timer_get_time();
+  int64_t leadUs = (int64_t)TX_SAMPLE_LEAD_MS * 1000;
+  int64_t intervalUs = (int64_t)slotIntervalMs * 1000;
+  int64_t afterUs = slotBaseUs > nowUs + leadUs ? slotBaseUs : nowUs + leadUs;
+  slotBaseUs = slotOriginUs + ((afterUs - slotOriginUs) / intervalUs + 1) * intervalUs;
+
+  uint32_t jitterMs = TX_SLOT_JITTER_MS ? esp_random() % (TX_SLOT_JITTER_MS + 1) : 0;
+  slotJitterUs = (int64_t)jitterMs * 1000;
+  esp_timer_start_once(slotTimer, slotBaseUs + slotJitterUs - leadUs - nowUs);
+}
+
+// LoRa DIO1: transmission finished
+void ARDUINO_ISR_ATTR onTxDone() {
+  txDoneFlag = true;
+}
 
 // Function declarations
-float getAverageCurrent();
+void startCurrentSampling(unsigned long now);
+bool serviceCurrentSampling(unsigned long now);
+void startMoistureSampling(unsigned long now);
+bool serviceMoistureSampling(unsigned long now);
+void beginMoistureAcquisition(unsigned long now);
+void setMoistureProbePower(bool on);
+void reportReading(const char* reportWhy);
+const char* checkReportPolicy();
+void noteReported(int32_t depthMm, float moisturePercent);
+void serviceSerialCommands();
+bool writeINA219Register(uint8_t addr, uint8_t reg, uint16_t value);
+bool readINA219Register(uint8_t addr, uint8_t reg, uint16_t* value);
 float calculateDepth(float current_mA);
 float calculatePercentage(float current_mA);
-int getAverageMoisture();
 float calculateMoisturePercent(int rawValue);
-void updateOLEDDisplay(float current_mA, float depthInches, float percentage, float moisturePercent, bool hasWaterLevel, bool loraTxOk);
+void updateOLEDDisplay(float current_mA, float depthInches, float percentage, float moisturePercent, bool hasWaterLevel);
+void drawStatusHeader();
 bool initLoRa();
 bool transmitSensorData(float current_mA, float moisturePercent);
+bool startPacketTransmit(uint8_t* data, size_t len, uint8_t msgType, uint8_t sequence);
+void serviceTransmit(unsigned long now);
+void serviceChannelTransmit(unsigned long now);
+void startSlotTimer(uint32_t firstSlotMs);
+void startBootCycle();
+void runSleepCycle();
+void storeSleepReading(bool rainWake);
+void markReadingsSent();
+bool batchFull();
+bool transmitBatch();
+void goToDeepSleep();
+int64_t rtcTimeUs();
+#if MOISTURE_ULP
+bool startMoistureUlp();
+uint8_t collectMoistureUlp();
+#endif
+bool serviceRainOnset(unsigned long now);
+void idleSleep();
+void updateBatteryGauge();
+void updateDiagnostics();
+void printFaults(uint16_t faults);
+void addCurrentSample(uint8_t ch, int32_t current_uA);
+void initStormMode();
+void startStormCapture(unsigned long now);
+void serviceStormCapture(unsigned long now);
+void summariseStorm();
+void serviceStormTransmit(unsigned long now);
 
 void setup() {
-  Serial.begin(115200);
-  delay(1000);
-
-  Serial.println("River Unit - Hydrostatic Sensor + LoRa TX");
-  Serial.println("==========================================");
-  Serial.println("Board: Heltec WiFi LoRa 32 V3");
+  #if RIVER_DEEP_SLEEP
+    warmWake = esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_UNDEFINED;
+    gpio_deep_sleep_hold_dis();
+    gpio_hold_dis((gpio_num_t)VEXT_CTRL);
+    #if MOISTURE_POWER_GATING
+      gpio_hold_dis((gpio_num_t)MOISTURE_POWER_PIN);
+    #endif
+    #if BATTERY_GAUGE
+      gpio_hold_dis((gpio_num_t)VBAT_CTRL_PIN);
+    #endif
+    #if RAIN_ONSET_ENABLED
+      rtc_gpio_deinit((gpio_num_t)RAIN_DO_PIN);  // Back to digital after ext0 wake
+    #endif
+  #endif
 
-  // Enable Vext power for OLED
-  pinMode(VEXT_CTRL, OUTPUT);
-  digitalWrite(VEXT_CTRL, LOW);  // LOW = ON for Vext
-  delay(100);
-
-  // Initialize I2C buses
-  Wire.begin(OLED_SDA, OLED_SCL);
-  I2C_INA219.begin(INA219_SDA, INA219_SCL);
-  Serial.println("I2C: OLED on GPIO17/18, INA219 on GPIO1/2");
+  Serial.begin(115200);
+  unsigned long vextOnMs = millis();
+  if (!warmWake) {
+    // Enable Vext power for OLED and hold it in reset - it settles while
+    // the sensors and radio start
+    pinMode(VEXT_CTRL, OUTPUT);
+    digitalWrite(VEXT_CTRL, LOW);  // LOW = ON for Vext
+    pinMode(OLED_RST, OUTPUT);
+    digitalWrite(OLED_RST, LOW);
+
+    // USB CDC: give a host a moment to attach so the banner isn't lost
+    while (!Serial && millis() < SERIAL_WAIT_MS) delay(1);
+
+    Serial.println("River Unit - Hydrostatic Sensor + LoRa TX");
+    Serial.println("==========================================");
+    Serial.println("Board: Heltec WiFi LoRa 32 V3");
+  } else {
+    // Deep-sleep wake: OLED stays unpowered
+    pinMode(VEXT_CTRL, OUTPUT);
+    digitalWrite(VEXT_CTRL, HIGH);
+  }
 
-  // Initialize OLED reset pin
-  pinMode(OLED_RST, OUTPUT);
-  digitalWrite(OLED_RST, LOW);
-  delay(20);
-  digitalWrite(OLED_RST, HIGH);
+  // Initialize INA219 I2C bus
+  I2C_INA219.begin(INA219_SDA, INA219_SCL, INA219_I2C_CLOCK_HZ);
+  Serial.print("I2C: OLED on GPIO17/18, INA219 on GPIO");
+  Serial.print(INA219_SDA);
+  Serial.print("/");
+  Serial.print(INA219_SCL);
+  Serial.println(" @ 400 kHz");
+
+  // Probe every INA219 address on the bus
+  for (uint8_t i = 0; i < MAX_CURRENT_CHANNELS; i++) {
+    if (!ina219Devices[i].begin(&I2C_INA219)) continue;
+
+    channelSensor[channelCount] = &ina219Devices[i];
+    channelAddr[channelCount] = INA219_CHANNEL_ADDRS[i];
+    if (!warmWake) filterInit(&currentFilter[channelCount], CURRENT_FILTER_SHIFT);
+    lastChannelCurrent[channelCount] = 0.0;
+    channelCount++;
+
+    Serial.print("INA219 channel ");
+    Serial.print(channelCount - 1);
+    Serial.print(" at 0x");
+    Serial.println(INA219_CHANNEL_ADDRS[i], HEX);
+  }
 
-  // Initialize the INA219
-  if (!ina219.begin(&I2C_INA219)) {
+  ina219Available = channelCount > 0;
+  if (!ina219Available) {
     Serial.println("INA219 not found - water level disabled");
-    ina219Available = false;
   } else {
-    Serial.println("INA219 initialized successfully");
-    ina219Available = true;
+    Serial.print("INA219 initialized successfully (");
+    Serial.print(channelCount);
+    Serial.println(" channel(s))");
+    #if INA219_HW_AVERAGING
+      Serial.println("INA219: on-chip 128-sample averaging, triggered conversions");
+    #endif
+    if (channelCount > 1 && LORA_IMPLICIT_HEADER) {
+      Serial.println("Implicit LoRa header: only channel 0 is sent");
+    }
   }
 
-  // Initialize the OLED display
-  if (!display.begin(SSD1306_SWITCHCAPVCC, SCREEN_ADDRESS)) {
-    Serial.println("OLED display failed!");
-    while (1) delay(1000);
+  // Load depth calibration (send "CAL" over serial to view or capture)
+  if (calLoad(&depthCal)) {
+    Serial.println("Depth calibration loaded from NVS");
+  } else {
+    Serial.println("Depth calibration: default 4-20 mA linear");
   }
-  Serial.println("OLED display initialized");
 
   // Initialize moisture sensor pin
   pinMode(MOISTURE_SENSOR_PIN, INPUT);
   analogReadResolution(12);
   Serial.println("Moisture sensor on GPIO4");
 
+  #if MOISTURE_POWER_GATING
+    pinMode(MOISTURE_POWER_PIN, OUTPUT);
+    digitalWrite(MOISTURE_POWER_PIN, LOW);
+    Serial.println("Moisture probe power gated on GPIO6");
+  #endif
+
+  if (!warmWake) {
+    diagInit(&sensorDiag);
+  }
+
+  #if BATTERY_GAUGE
+    // Divider stays on while awake (~8 uA) so it has settled by the first read
+    pinMode(VBAT_CTRL_PIN, OUTPUT);
+    digitalWrite(VBAT_CTRL_PIN, VBAT_CTRL_ON);
+    if (!warmWake) {
+      batteryReset(&batteryGauge);
+    }
+    #if BATTERY_INA219_ADDR
+      batteryMonitorAvailable = writeINA219Register(BATTERY_INA219_ADDR, INA219_REG_CFG, INA219_CFG_CONTINUOUS_128S);
+    #endif
+    Serial.print("Battery gauge: VBAT on GPIO1, ");
+    Serial.println(batteryMonitorAvailable ? "battery INA219 found" : "modelled load");
+  #endif
+
+  #if RAIN_ONSET_ENABLED
+    // DO has a pull-up on most LM393 boards; the internal one keeps an
+    // unconnected pin from firing
+    pinMode(RAIN_DO_PIN, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(RAIN_DO_PIN), onRainOnset, FALLING);
+    Serial.println("Rain onset interrupt on GPIO5 (LM393 DO)");
+  #endif
+
+  #if RIVER_DEEP_SLEEP
+    // The radio is only brought up on wakes that transmit
+    if (warmWake) {
+      setupDoneMs = millis();
+      runSleepCycle();
+    }
+  #else
+    // First reading converts while the radio and OLED start; it is sent as
+    // soon as it completes (the slot schedule starts one interval later)
+    #if !BOOT_SPLASH
+      startBootCycle();
+    #endif
+  #endif
+
   // Initialize LoRa
   loraInitialized = initLoRa();
 
-  // Display startup screen
-  display.clearDisplay();
-  display.setTextSize(1);
-  display.setTextColor(SSD1306_WHITE);
-  display.setCursor(0, 0);
-  display.println("RIVER UNIT");
-  display.println("LoRa Sensor TX");
-  display.println();
-  if (loraInitialized) {
-    display.println("LoRa: OK");
-    display.print("Freq: ");
-    display.print(LORA_FREQUENCY, 1);
-    display.println(" MHz");
-  } else {
-    display.println("LoRa: FAILED!");
+  // Initialize the OLED display once Vext has settled
+  while (millis() - vextOnMs < OLED_POWER_UP_MS) delay(1);
+  Wire.begin(OLED_SDA, OLED_SCL);
+  digitalWrite(OLED_RST, HIGH);
+  if (!display.begin(SSD1306_SWITCHCAPVCC, SCREEN_ADDRESS)) {
+    Serial.println("OLED display failed!");
+    while (1) delay(1000);
   }
-  display.display();
-  delay(2000);
+  displayReady = true;
+  Serial.println("OLED display initialized");
+
+  #if BOOT_SPLASH
+    // Display startup screen
+    display.clearDisplay();
+    display.setTextSize(1);
+    display.setTextColor(SSD1306_WHITE);
+    display.setCursor(0, 0);
+    display.println("RIVER UNIT");
+    display.println("LoRa Sensor TX");
+    display.println();
+    if (loraInitialized) {
+      display.println("LoRa: OK");
+      display.print("Freq: ");
+      display.print(LORA_FREQUENCY, 1);
+      display.println(" MHz");
+    } else {
+      display.println("LoRa: FAILED!");
+    }
+    display.display();
+    delay(BOOT_SPLASH_MS);
+  #endif
+
+  setupDoneMs = millis();
+  Serial.print("Setup done in ");
+  Serial.print(setupDoneMs);
+  Serial.println(" ms");
 
   Serial.println();
   Serial.println("Starting measurements...");
   Serial.println("==========================================");
+
+  #if RIVER_DEEP_SLEEP
+    Serial.print("Deep sleep mode: sample every ");
+    Serial.print(SLEEP_SAMPLE_INTERVAL_SEC);
+    Serial.print(" s, heartbeat ");
+    Serial.print(REPORT_HEARTBEAT_MS / 1000);
+    Serial.println(" s");
+    sleepNextWakeUs = rtcTimeUs();
+    runSleepCycle();
+  #else
+    #if STORM_MODE_ENABLED
+      initStormMode();
+    #endif
+    startSlotTimer(cyclePending ? TX_INTERVAL_MS : TX_SAMPLE_LEAD_MS);
+  #endif
+}
+
+// Start the first awake-mode reading straight away, ahead of the radio and
+// OLED (it transmits once sampled, outside the slot schedule)
+void startBootCycle() {
+  unsigned long now = millis();
+  if (ina219Available) {
+    startCurrentSampling(now);
+  }
+  startMoistureSampling(now);
+  cycleTxUs = 0;
+  cyclePending = true;
 }
 
+// Start the drift-free TX slot schedule, first slot firstSlotMs from now
+// (at least one sample lead)
+void startSlotTimer(uint32_t firstSlotMs) {
+  const esp_timer_create_args_t args = {
+    .callback = &onSlotTimer,
+    .arg = NULL,
+    .dispatch_method = ESP_TIMER_TASK,
+    .name = "txslot",
+    .skip_unhandled_events = true
+  };
+
+  if (esp_timer_create(&args, &slotTimer) != ESP_OK) {
+    Serial.println("Slot timer create failed!");
+    return;
+  }
+
+  if (firstSlotMs < TX_SAMPLE_LEAD_MS) firstSlotMs = TX_SAMPLE_LEAD_MS;
+  slotBaseUs = esp_timer_get_time() + (int64_t)firstSlotMs * 1000;
+  slotOriginUs = slotBaseUs;
+  slotJitterUs = 0;
+  esp_timer_start_once(slotTimer, (uint64_t)(firstSlotMs - TX_SAMPLE_LEAD_MS) * 1000 + 1);
+
+  Serial.print("TX slots: every ");
+  Serial.print(TX_INTERVAL_MS);
+  Serial.print(" ms, jitter 0-");
+  Serial.print(TX_SLOT_JITTER_MS);
+  Serial.print(" ms, sample lead ");
+  Serial.print(TX_SAMPLE_LEAD_MS);
+  Serial.println(" ms");
+}
+
+// ===== DEEP SLEEP CYCLE =====
+
+// RTC clock in microseconds - keeps counting through deep sleep
+int64_t rtcTimeUs() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (int64_t)tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+// One deep-sleep wake: sample, store, transmit if due, sleep again.
+// Never returns.
+void runSleepCycle() {
+  bool rainWake = esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_EXT0;
+  bool txDue = false;
+  sleepWakeCount++;
+
+  // Run the normal samplers to completion
+  unsigned long now = millis();
+  if (ina219Available) {
+    startCurrentSampling(now);
+  }
+  #if MOISTURE_ULP
+    // The ULP has been sampling moisture all along; it only wakes us to
+    // report. Power-on takes one normal reading as the ULP's baseline.
+    if (!warmWake) {
+      startMoistureSampling(now);
+    } else if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_ULP) {
+      rainWake = collectMoistureUlp() == ULP_WAKE_WET;
+      txDue = true;
+    } else {
+      lastMoistureRaw = RTC_SLOW_MEM[ULP_LAST] & 0xFFFF;
+      lastMoisturePercent = calculateMoisturePercent(lastMoistureRaw);
+    }
+  #else
+    startMoistureSampling(now);
+  #endif
+
+  // A wake that will transmit brings the radio up while the INA219 converts
+  if ((txDue || rainWake) && warmWake && !loraInitialized) {
+    loraInitialized = initLoRa();
+  }
+
+  while (currentSampling || moistureSampling) {
+    now = millis();
+    serviceCurrentSampling(now);
+    serviceMoistureSampling(now);
+    delay(1);
+  }
+
+  #if MOISTURE_ULP
+    if (!warmWake) {
+      startMoistureUlp();
+    }
+  #endif
+
+  storeSleepReading(rainWake);
+
+  Serial.print("Wake #");
+  Serial.print(sleepWakeCount);
+  Serial.print(rainWake ? " (rain)" : "");
+  Serial.print(": ");
+  Serial.print(lastCurrent, 2);
+  Serial.print(" mA, moisture ");
+  Serial.print(lastMoisturePercent, 0);
+  Serial.print("%, ");
+  Serial.print(sleepRingCount);
+  Serial.println(" stored");
+
+  // Radio only on wakes that transmit
+  forceReport = txDue || rainWake;
+  updateDiagnostics();
+  updateBatteryGauge();
+  const char* reportWhy = checkReportPolicy();
+  if (reportWhy || batchFull()) {
+    if (!loraInitialized) {
+      loraInitialized = initLoRa();
+    }
+    reportReading(reportWhy);
+
+    // Wait for the packet (and any ChannelPacket) to finish; serviceTransmit()
+    // marks the stored readings it covered as delivered
+    unsigned long txStart = millis();
+    while ((txBusy || channelTxPending) && millis() - txStart < SLEEP_TX_WAIT_MS) {
+      now = millis();
+      serviceTransmit(now);
+      serviceChannelTransmit(now);
+      delay(1);
+    }
+  }
+
+  goToDeepSleep();
+}
+
+// Append the latest reading to the RTC ring buffer (oldest is overwritten)
+void storeSleepReading(bool rainWake) {
+  SleepReading* r = &sleepRing[sleepRingHead];
+  r->time = (uint32_t)(rtcTimeUs() / 1000000LL);
+  r->current_cmA = (uint16_t)constrain(lroundf(lastCurrent * 100.0), 0, 65535);
+  r->moisture = (uint8_t)constrain(lroundf(lastMoisturePercent * 2.0), 0, 200);
+  r->flags = rainWake ? SLEEP_READING_RAIN : 0;
+
+  sleepRingHead = (sleepRingHead + 1) % SLEEP_RING_SIZE;
+  if (sleepRingCount < SLEEP_RING_SIZE) sleepRingCount++;
+  if (readingsSinceTx < SLEEP_RING_SIZE) readingsSinceTx++;
+}
+
+// Flag the stored readings covered by the packet that just went out as
+// delivered (readings stored while it was on air stay queued)
+void markReadingsSent() {
+  for (uint8_t i = 0; i < txRingCount; i++) {
+    uint8_t idx = (txRingHead + SLEEP_RING_SIZE - 1 - i) % SLEEP_RING_SIZE;
+    sleepRing[idx].flags |= SLEEP_READING_SENT;
+  }
+  readingsSinceTx = (sleepRingHead + SLEEP_RING_SIZE - txRingHead) % SLEEP_RING_SIZE;
+  txRingCount = 0;
+}
+
+// Enough readings queued for a batch frame (BATCH_UPLINK)
+bool batchFull() {
+  return BATCH_UPLINK && readingsSinceTx >= BATCH_READINGS;
+}
+
+void goToDeepSleep() {
+  // Put the INA219s and radio in their low-power modes
+  for (uint8_t i = 0; i < channelCount; i++) {
+    writeINA219Register(channelAddr[i], INA219_REG_CFG, INA219_CFG_POWER_DOWN);
+  }
+  if (batteryMonitorAvailable) {
+    writeINA219Register(BATTERY_INA219_ADDR, INA219_REG_CFG, INA219_CFG_POWER_DOWN);
+  }
+  if (loraInitialized) {
+    radio.sleep();
+  }
+
+  // OLED off, Vext (and the probe supply) held off through sleep
+  if (displayReady) {
+    display.ssd1306_command(SSD1306_DISPLAYOFF);
+  }
+  digitalWrite(VEXT_CTRL, HIGH);
+  gpio_hold_en((gpio_num_t)VEXT_CTRL);
+  #if MOISTURE_POWER_GATING
+    gpio_hold_en((gpio_num_t)MOISTURE_POWER_PIN);
+  #endif
+  #if BATTERY_GAUGE
+    digitalWrite(VBAT_CTRL_PIN, !VBAT_CTRL_ON);
+    gpio_hold_en((gpio_num_t)VBAT_CTRL_PIN);
+    batteryAwakeMs += millis() - batteryMarkMs;
+  #endif
+  gpio_deep_sleep_hold_en();
+
+  // Next wake on the fixed SLEEP_SAMPLE_INTERVAL_SEC grid (with the ULP
+  // running, the ULP decides when to wake instead)
+  int64_t nowUs = rtcTimeUs();
+  do {
+    sleepNextWakeUs += (int64_t)SLEEP_SAMPLE_INTERVAL_SEC * uS_TO_S_FACTOR;
+  } while (sleepNextWakeUs <= nowUs);
+  #if MOISTURE_ULP
+    esp_sleep_enable_ulp_wakeup();
+    sleepNextWakeUs = nowUs + (int64_t)MOISTURE_ULP_REPORT_SAMPLES * MOISTURE_ULP_PERIOD_MS * 1000;
+  #else
+    esp_sleep_enable_timer_wakeup((uint64_t)(sleepNextWakeUs - nowUs));
+  #endif
+
+  // Rain onset wakes early - only armed while the sensor is still dry
+  #if RAIN_ONSET_ENABLED
+    if (digitalRead(RAIN_DO_PIN) == HIGH) {
+      esp_sleep_enable_ext0_wakeup((gpio_num_t)RAIN_DO_PIN, 0);
+    }
+  #endif
+
+  Serial.print("Sleeping ");
+  Serial.print((long)((sleepNextWakeUs - nowUs) / 1000));
+  Serial.println(" ms");
+  Serial.flush();
+
+  esp_deep_sleep_start();
+}
+
+#if MOISTURE_ULP
+// ===== ULP MOISTURE PROGRAM =====
+// Runs on the ULP FSM every MOISTURE_ULP_PERIOD_MS, main cores asleep.
+// R3 = data base address, R0 = new sample, R1/R2 = scratch.
+// SUBR sets the overflow flag when the result is negative (Rs1 < Rs2).
+
+enum {
+  L_NEW_MIN, L_MIN_DONE, L_NEW_MAX, L_MAX_DONE, L_CHECK_WET, L_IS_WET,
+  L_CHECK_DELTA, L_DELTA_NEG, L_DELTA_ABS, L_WAKE, L_DONE
+};
+
+static const ulp_insn_t moistureUlpProgram[] = {
+  I_MOVI(R3, 0),
+  I_ADC(R0, 0, MOISTURE_ADC_CHANNEL),       // R0 = raw moisture
+  I_ST(R0, R3, ULP_LAST),
+
+  // min / max
+  I_LD(R1, R3, ULP_MIN),
+  I_SUBR(R2, R0, R1),
+  M_BXF(L_NEW_MIN),                         // R0 < min
+  M_BX(L_MIN_DONE),
+  M_LABEL(L_NEW_MIN),
+  I_ST(R0, R3, ULP_MIN),
+  M_LABEL(L_MIN_DONE),
+
+  I_LD(R1, R3, ULP_MAX),
+  I_SUBR(R2, R1, R0),
+  M_BXF(L_NEW_MAX),                         // max < R0
+  M_BX(L_MAX_DONE),
+  M_LABEL(L_NEW_MAX),
+  I_ST(R0, R3, ULP_MAX),
+  M_LABEL(L_MAX_DONE),
+
+  // sum += raw >> 4, count++
+  I_RSHI(R1, R0, 4),
+  I_LD(R2, R3, ULP_SUM),
+  I_ADDR(R2, R2, R1),
+  I_ST(R2, R3, ULP_SUM),
+  I_LD(R1, R3, ULP_COUNT),
+  I_ADDI(R1, R1, 1),
+  I_ST(R1, R3, ULP_COUNT),
+
+  // Report due: count >= limit
+  I_LD(R2, R3, ULP_LIMIT),
+  I_SUBR(R2, R1, R2),
+  M_BXF(L_CHECK_WET),
+  I_MOVI(R1, ULP_WAKE_REPORT),
+  M_BX(L_WAKE),
+
+  // Wet: raw < wet threshold
+  M_LABEL(L_CHECK_WET),
+  I_LD(R1, R3, ULP_WET),
+  I_SUBR(R2, R0, R1),
+  M_BXF(L_IS_WET),
+  M_BX(L_CHECK_DELTA),
+  M_LABEL(L_IS_WET),
+  I_MOVI(R1, ULP_WAKE_WET),
+  M_BX(L_WAKE),
+
+  // Delta: |raw - baseline| >= delta
+  M_LABEL(L_CHECK_DELTA),
+  I_LD(R1, R3, ULP_BASELINE),
+  I_SUBR(R2, R0, R1),
+  M_BXF(L_DELTA_NEG),
+  M_BX(L_DELTA_ABS),
+  M_LABEL(L_DELTA_NEG),
+  I_SUBR(R2, R1, R0),
+  M_LABEL(L_DELTA_ABS),
+  I_LD(R1, R3, ULP_DELTA),
+  I_SUBR(R2, R2, R1),
+  M_BXF(L_DONE),
+  I_MOVI(R1, ULP_WAKE_DELTA),
+
+  M_LABEL(L_WAKE),
+  I_ST(R1, R3, ULP_REASON),
+  I_WAKE(),
+
+  M_LABEL(L_DONE),
+  I_HALT()
+};
+
+// Reset the ULP statistics; baseline is the value just reported
+void resetMoistureUlpStats(uint16_t baseline) {
+  RTC_SLOW_MEM[ULP_COUNT] = 0;
+  RTC_SLOW_MEM[ULP_MIN] = 0xFFFF;
+  RTC_SLOW_MEM[ULP_MAX] = 0;
+  RTC_SLOW_MEM[ULP_SUM] = 0;
+  RTC_SLOW_MEM[ULP_BASELINE] = baseline;
+  RTC_SLOW_MEM[ULP_REASON] = 0;
+
+  // Only watch for the wet transition while the probe is dry
+  RTC_SLOW_MEM[ULP_WET] = baseline >= MOISTURE_ULP_WET_RAW ? MOISTURE_ULP_WET_RAW : 0;
+}
+
+// Load and start the ULP program (power-on only; it keeps running after)
+bool startMoistureUlp() {
+  ulp_adc_cfg_t adcCfg = {
+    .adc_n = ADC_UNIT_1,
+    .channel = (adc_channel_t)MOISTURE_ADC_CHANNEL,
+    .atten = ADC_ATTEN_DB_12,
+    .width = ADC_BITWIDTH_12,
+    .ulp_mode = ADC_ULP_MODE_FSM,
+  };
+  if (ulp_adc_init(&adcCfg) != ESP_OK) {
+    Serial.println("ULP ADC init failed - moisture not sampled");
+    return false;
+  }
+
+  RTC_SLOW_MEM[ULP_DELTA] = MOISTURE_ULP_DELTA_RAW;
+  RTC_SLOW_MEM[ULP_LIMIT] = MOISTURE_ULP_REPORT_SAMPLES;
+  resetMoistureUlpStats(lastMoistureRaw);
+
+  size_t size = sizeof(moistureUlpProgram) / sizeof(ulp_insn_t);
+  if (ulp_process_macros_and_load(ULP_DATA_WORDS, moistureUlpProgram, &size) != ESP_OK ||
+      ulp_set_wakeup_period(0, MOISTURE_ULP_PERIOD_MS * 1000) != ESP_OK ||
+      ulp_run(ULP_DATA_WORDS) != ESP_OK) {
+    Serial.println("ULP program load failed - moisture not sampled");
+    return false;
+  }
+
+  Serial.print("ULP moisture sampling every ");
+  Serial.print(MOISTURE_ULP_PERIOD_MS);
+  Serial.println(" ms");
+  return true;
+}
+
+// Pick up the ULP statistics after a ULP wake and start a new window.
+// Returns the wake reason (ULP_WAKE_*).
+uint8_t collectMoistureUlp() {
+  uint8_t reason = RTC_SLOW_MEM[ULP_REASON] & 0xFFFF;
+  uint16_t count = RTC_SLOW_MEM[ULP_COUNT] & 0xFFFF;
+  uint16_t last = RTC_SLOW_MEM[ULP_LAST] & 0xFFFF;
+
+  // Threshold/delta wakes report the sample that tripped; reports the mean
+  if (reason == ULP_WAKE_REPORT && count > 0) {
+    lastMoistureRaw = ((uint32_t)(RTC_SLOW_MEM[ULP_SUM] & 0xFFFF) << 4) / count;
+  } else {
+    lastMoistureRaw = last;
+  }
+  lastMoisturePercent = calculateMoisturePercent(lastMoistureRaw);
+
+  Serial.print("ULP wake (");
+  Serial.print(reason == ULP_WAKE_WET ? "wet" : reason == ULP_WAKE_DELTA ? "delta" : "report");
+  Serial.print("): ");
+  Serial.print(count);
+  Serial.print(" samples, raw min ");
+  Serial.print(RTC_SLOW_MEM[ULP_MIN] & 0xFFFF);
+  Serial.print(" max ");
+  Serial.print(RTC_SLOW_MEM[ULP_MAX] & 0xFFFF);
+  Serial.print(" now ");
+  Serial.println(last);
+
+  resetMoistureUlpStats(last);
+  return reason;
+}
+#endif
+
 bool initLoRa() {
   Serial.print("Initializing LoRa SX1262... ");
 
@@ -192,6 +1238,19 @@ bool initLoRa() {
     return false;
   }
 
+  // Implicit header: length, coding rate and CRC come from lora_config.h
+  #if LORA_IMPLICIT_HEADER
+    state = radio.implicitHeader(LORA_IMPLICIT_LEN);
+    if (state == RADIOLIB_ERR_NONE) {
+      state = radio.setCRC(LORA_CRC_BYTES);
+    }
+    if (state != RADIOLIB_ERR_NONE) {
+      Serial.print("FAILED! Implicit header error: ");
+      Serial.println(state);
+      return false;
+    }
+  #endif
+
   Serial.println("SUCCESS!");
   Serial.print("  Frequency: ");
   Serial.print(LORA_FREQUENCY);
@@ -203,10 +1262,18 @@ bool initLoRa() {
   Serial.print(LORA_SPREADING);
   Serial.print(", CR: 4/");
   Serial.println(LORA_CODING_RATE);
+  #if LORA_IMPLICIT_HEADER
+    Serial.print("  Header: implicit, ");
+    Serial.print(LORA_IMPLICIT_LEN);
+    Serial.println(" bytes");
+  #endif
   Serial.print("  TX Power: ");
   Serial.print(LORA_TX_POWER);
   Serial.println(" dBm");
 
+  // TX-done interrupt for startTransmit()
+  radio.setDio1Action(onTxDone);
+
   return true;
 }
 
@@ -216,14 +1283,14 @@ bool transmitSensorData(float current_mA, float moisturePercent) {
   // Build packet
   SensorPacket pkt;
   pkt.msgType = MSG_TYPE_SENSOR;
-  pkt.sourceId = UNIT_ID_RIVER;
+  pkt.sourceId = NODE_ID;
   pkt.relayId = 0;  // Direct transmission (not relayed yet)
   pkt.sequence = packetSequence++;
   pkt.current_mA = current_mA;
-  pkt.moisturePercent = moisturePercent;
+  pkt.moisture_dPct = (uint16_t)constrain(lroundf(moisturePercent * 10.0), 0, 1000);
+  pkt.faultFlags = diagFaults;
   pkt.rssi = 0;  // Will be filled by relay
-  pkt.batteryPercent = 100;  // TODO: Read actual battery level
-  pkt.checksum = calculateChecksum(&pkt);
+  pkt.batteryPercent = batteryLevel;
 
   Serial.print("TX Packet #");
   Serial.print(pkt.sequence);
@@ -233,40 +1300,699 @@ bool transmitSensorData(float current_mA, float moisturePercent) {
   Serial.print(moisturePercent, 1);
   Serial.print("% ... ");
 
-  // Transmit
-  int state = radio.transmit((uint8_t*)&pkt, sizeof(SensorPacket));
+  // Start transmit; serviceTransmit() reports the result
+  #if SENSOR_PACKET_COMPACT
+    uint8_t frame[COMPACT_FRAME_LEN];
+    size_t len = encodeCompactFrame(&pkt, frame);
+    if (!startPacketTransmit(frame, len, pkt.msgType, pkt.sequence)) return false;
+  #else
+    if (!startPacketTransmit(packetEncode(&pkt), packetLength(&pkt), pkt.msgType, pkt.sequence)) return false;
+  #endif
+
+  // Deep sleep: the readings stored since the last transmit count as delivered
+  txRingHead = sleepRingHead;
+  txRingCount = readingsSinceTx;
+  return true;
+}
 
-  if (state == RADIOLIB_ERR_NONE) {
-    Serial.println("OK");
-    return true;
-  } else {
+// Send the oldest queued readings, up to BATCH_MAX_READINGS, as one batch
+// frame. A longer backlog (after failed transmits) stays queued and goes
+// out oldest first, one frame per report, until it has drained.
+bool transmitBatch() {
+  if (!loraInitialized) return false;
+
+  uint8_t count = min(readingsSinceTx, (uint8_t)BATCH_MAX_READINGS);
+  if (count == 0) return false;
+  uint8_t first = (sleepRingHead + SLEEP_RING_SIZE - readingsSinceTx) % SLEEP_RING_SIZE;
+
+  SensorBatch batch;
+  batch.sourceId = NODE_ID;
+  batch.sequence = packetSequence++;
+  batch.relayId = 0;
+  batch.rssi = 0;
+  batch.faultFlags = diagFaults;
+  batch.batteryPercent = batteryLevel;
+  batch.count = count;
+
+  // Oldest first, ages against the RTC clock
+  uint32_t nowSec = (uint32_t)(rtcTimeUs() / 1000000LL);
+  for (uint8_t i = 0; i < count; i++) {
+    const SleepReading* r = &sleepRing[(first + i) % SLEEP_RING_SIZE];
+    batch.readings[i].age_s = nowSec - r->time;
+    batch.readings[i].current_cmA = r->current_cmA;
+    batch.readings[i].moisture = r->moisture;
+    batch.readings[i].flags = r->flags & SLEEP_READING_RAIN ? BATCH_READING_RAIN : 0;
+  }
+
+  uint8_t frame[BATCH_FRAME_MAX_LEN];
+  size_t len = encodeBatchFrame(&batch, frame);
+
+  Serial.print("TX Batch #");
+  Serial.print(batch.sequence);
+  Serial.print(" - ");
+  Serial.print(count);
+  Serial.print(" readings in ");
+  Serial.print(len);
+  Serial.print(" bytes");
+  if (readingsSinceTx > count) {
+    Serial.print(" (");
+    Serial.print(readingsSinceTx - count);
+    Serial.print(" more queued)");
+  }
+  Serial.print(" ... ");
+
+  if (!startPacketTransmit(frame, len, MSG_TYPE_BATCH, batch.sequence)) return false;
+  // Delivered up to the end of this frame; later readings stay queued
+  txRingHead = (first + count) % SLEEP_RING_SIZE;
+  txRingCount = count;
+  return true;
+}
+
+// Hand a packet to the radio without waiting for airtime
+bool startPacketTransmit(uint8_t* data, size_t len, uint8_t msgType, uint8_t sequence) {
+  if (txBusy) {
+    Serial.println("BUSY - previous packet still on air");
+    return false;
+  }
+
+  txDoneFlag = false;
+  int state = radio.startTransmit(data, len);
+
+  if (state != RADIOLIB_ERR_NONE) {
     Serial.print("FAILED! Error: ");
     Serial.println(state);
     return false;
   }
+
+  Serial.println("started");
+  txBusy = true;
+  txMsgType = msgType;
+  txSequence = sequence;
+  txStartTime = millis();
+  return true;
+}
+
+// Finish the packet on air once DIO1 fires (or the timeout passes)
+void serviceTransmit(unsigned long now) {
+  if (!txBusy) return;
+  if (!txDoneFlag && now - txStartTime < TX_TIMEOUT_MS) return;
+
+  bool ok = txDoneFlag;
+  txDoneFlag = false;
+  txBusy = false;
+  radio.finishTransmit();
+  batteryAirtimeMs += now - txStartTime;
+
+  Serial.print(txMsgType == MSG_TYPE_CHANNELS ? "TX Channels #" :
+               txMsgType == MSG_TYPE_STORM ? "TX Storm #" :
+               txMsgType == MSG_TYPE_BATCH ? "TX Batch #" : "TX Packet #");
+  Serial.print(txSequence);
+  if (ok) {
+    Serial.print(" sent in ");
+    Serial.print(now - txStartTime);
+    Serial.println(" ms");
+  } else {
+    Serial.println(" FAILED! TX timeout");
+  }
+
+  if (txMsgType != MSG_TYPE_SENSOR && txMsgType != MSG_TYPE_BATCH) return;
+
+  if (ok && !bootPacketLogged) {
+    bootPacketLogged = true;
+    Serial.print(warmWake ? "Wake to first packet: " : "Boot to first packet: ");
+    Serial.print(now);
+    Serial.print(" ms (setup ");
+    Serial.print(setupDoneMs);
+    Serial.println(" ms)");
+  }
+
+  loraTxOk = ok;
+  if (ok) {
+    markReadingsSent();
+  } else {
+    reportPrimed = false;  // Receivers didn't get it - resend next cycle (readings stay queued)
+  }
+  if (displayReady) {
+    drawStatusHeader();
+    display.display();
+  }
+
+  // Storm summary, then extra gauges, follow once the relays have passed
+  // the previous packet on
+  unsigned long followTime = now + CHANNEL_TX_DELAY_MS;
+  if (ok && stormReady) {
+    stormReady = false;
+    stormTxPending = true;
+    stormTxTime = followTime;
+    stormPkt.sequence = txSequence;
+    followTime += CHANNEL_TX_DELAY_MS;
+  }
+  if (ok && channelCount > 1 && !LORA_IMPLICIT_HEADER) {
+    channelTxPending = true;
+    channelTxTime = followTime;
+    channelTxSequence = txSequence;
+  }
+}
+
+// Send the per-channel currents once CHANNEL_TX_DELAY_MS has passed
+void serviceChannelTransmit(unsigned long now) {
+  if (!channelTxPending || txBusy || stormTxPending || (long)(now - channelTxTime) < 0) return;
+  channelTxPending = false;
+
+  ChannelPacket pkt;
+  memset(&pkt, 0, sizeof(ChannelPacket));
+  pkt.msgType = MSG_TYPE_CHANNELS;
+  pkt.sourceId = NODE_ID;
+  pkt.relayId = 0;
+  pkt.sequence = channelTxSequence;
+  pkt.channelCount = channelCount;
+  for (uint8_t i = 0; i < channelCount; i++) {
+    pkt.current_cmA[i] = (uint16_t)constrain(lroundf(lastChannelCurrent[i] * 100.0), 0, 65535);
+  }
+  pkt.rssi = 0;
+
+  Serial.print("TX Channels #");
+  Serial.print(pkt.sequence);
+  Serial.print(" (");
+  Serial.print(channelCount);
+  Serial.print(") ... ");
+
+  startPacketTransmit(packetEncode(&pkt), packetLength(&pkt), pkt.msgType, pkt.sequence);
 }
 
 void loop() {
+  unsigned long now = millis();
+
+  // Rain onset starts an extra cycle right away; the schedule is untouched.
+  // A storm burst owns channel 0, so new cycles wait for it to finish.
+  if (!cyclePending && !stormCapturing && serviceRainOnset(now)) {
+    if (ina219Available) {
+      startCurrentSampling(now);
+    }
+    startMoistureSampling(now);
+    cycleTxUs = 0;
+    cyclePending = true;
+    cycleRainOnset = true;
+    forceReport = true;
+    stormTrigger = true;
+  }
+
+  // The slot timer fired TX_SAMPLE_LEAD_MS ahead of the slot: sample now,
+  // transmit on the slot boundary
+  if (!cyclePending && !stormCapturing && slotDue) {
+    portENTER_CRITICAL(&slotMux);
+    cycleTxUs = pendingTxUs;
+    slotDue = false;
+    portEXIT_CRITICAL(&slotMux);
+
+    if (ina219Available) {
+      startCurrentSampling(now);
+    }
+
+    // Read soil moisture sensor (only every MOISTURE_READ_INTERVAL_MS)
+    unsigned long slotMs = (unsigned long)(cycleTxUs / 1000);
+    if (slotMs - lastMoistureReadTime >= MOISTURE_READ_INTERVAL_MS || lastMoistureReadTime == 0) {
+      startMoistureSampling(now);
+      lastMoistureReadTime = slotMs;
+    }
+
+    cyclePending = true;
+  }
+
+  serviceCurrentSampling(now);
+  serviceMoistureSampling(now);
+  serviceSerialCommands();
+  serviceTransmit(now);
+  serviceStormTransmit(now);
+  serviceChannelTransmit(now);
+  serviceStormCapture(now);
+
+  // Report once every sampler started this cycle has published and the
+  // slot boundary has arrived
+  if (cyclePending && !currentSampling && !moistureSampling &&
+      (cycleTxUs == 0 || esp_timer_get_time() >= cycleTxUs)) {
+    cyclePending = false;
+    updateDiagnostics();
+    updateBatteryGauge();
+    #if BATCH_UPLINK
+      storeSleepReading(cycleRainOnset);
+    #endif
+    cycleRainOnset = false;
+    reportReading(checkReportPolicy());
+
+    // Sample faster while the level is changing quickly (unless saving energy)
+    slotIntervalMs = fabs(depthRateMmMin) >= REPORT_FLOOD_RATE_MM_MIN && !batteryLow ?
+                     REPORT_FAST_INTERVAL_MS : TX_INTERVAL_MS;
+
+    // Storm burst between cycles on rain onset or a flood-rate change
+    #if STORM_MODE_ENABLED
+      if (ina219Available && !batteryLow &&
+          (stormTrigger || fabs(depthRateMmMin) >= STORM_RATE_MM_MIN) &&
+          (!stormRan || now - lastStormTime >= STORM_HOLDOFF_MS)) {
+        startStormCapture(now);
+      }
+      stormTrigger = false;
+    #endif
+  }
+
+  #if RIVER_LIGHT_SLEEP
+    if (!cyclePending && !channelTxPending && !stormTxPending && !stormCapturing && !txBusy) {
+      idleSleep();
+      return;
+    }
+  #endif
+
+  delay(1);
+}
+
+// ===== STORM MODE =====
+
+// Burst timer: read channel 0's latest conversion (esp_timer task context)
+void onStormSample(void* arg) {
+  if (stormCount >= STORM_SAMPLES) return;
+
+  // A failed read is skipped rather than stored as 0 mA; a bus that keeps
+  // failing ends the burst
+  uint16_t shunt;
+  if (!readINA219Register(channelAddr[0], INA219_REG_SHUNT, &shunt)) {
+    if (++stormReadErrors > STORM_MAX_READ_ERRORS) {
+      esp_timer_stop(stormTimer);
+      stormDone = true;
+    }
+    return;
+  }
+  stormSamples[stormCount] = (int16_t)shunt;
+
+  if (++stormCount >= STORM_SAMPLES) {
+    esp_timer_stop(stormTimer);
+    stormDone = true;
+  }
+}
+
+void initStormMode() {
+  const esp_timer_create_args_t args = {
+    .callback = &onStormSample,
+    .arg = NULL,
+    .dispatch_method = ESP_TIMER_TASK,
+    .name = "storm",
+    .skip_unhandled_events = true
+  };
+
+  if (esp_timer_create(&args, &stormTimer) != ESP_OK) {
+    Serial.println("Storm timer create failed!");
+    stormTimer = NULL;
+    return;
+  }
+
+  #if STORM_USE_ESP_DSP
+    dsps_fft2r_init_fc32(NULL, STORM_SAMPLES);
+    dsps_wind_hann_f32(stormWindow, STORM_SAMPLES);
+  #else
+    for (uint16_t i = 0; i < STORM_SAMPLES; i++) {
+      stormWindow[i] = 0.5 - 0.5 * cosf(2 * PI * i / (STORM_SAMPLES - 1));
+    }
+  #endif
+
+  Serial.print("Storm mode: ");
+  Serial.print(STORM_SAMPLES);
+  Serial.print(" samples @ ");
+  Serial.print(STORM_SAMPLE_HZ);
+  Serial.println(STORM_USE_ESP_DSP ? " Hz, ESP-DSP" : " Hz, scalar maths");
+}
+
+// Switch channel 0 to free-running conversions and start the burst timer.
+// New cycles are held off until the burst is summarised.
+void startStormCapture(unsigned long now) {
+  if (stormTimer == NULL || stormCapturing) return;
+
+  writeINA219Register(channelAddr[0], INA219_REG_CFG, INA219_CFG_STORM);
+  stormCount = 0;
+  stormReadErrors = 0;
+  stormDone = false;
+  stormCapturing = true;
+  stormRan = true;
+  lastStormTime = now;
+  esp_timer_start_periodic(stormTimer, 1000000 / STORM_SAMPLE_HZ);
+
+  Serial.print("Storm burst started (rate ");
+  Serial.print(depthRateMmMin, 1);
+  Serial.println(" mm/min)");
+}
+
+void serviceStormCapture(unsigned long now) {
+  if (!stormCapturing || !stormDone) return;
+  stormCapturing = false;
+
+  // Channel 0 goes back to triggered conversions when the next cycle starts
+  if (stormCount < STORM_SAMPLES) {
+    Serial.print("Storm burst aborted: ");
+    Serial.print(stormReadErrors);
+    Serial.println(" INA219 read errors");
+    return;
+  }
+  if (stormReadErrors > 0) {
+    Serial.print("Storm burst: skipped ");
+    Serial.print(stormReadErrors);
+    Serial.println(" failed INA219 reads");
+  }
+  summariseStorm();
+
+  // Make sure a SensorPacket goes out to carry it
+  stormReady = true;
+  forceReport = true;
+}
+
+#if !STORM_USE_ESP_DSP
+// In-place radix-2 complex FFT (interleaved re/im) - fallback without ESP-DSP
+void stormFft(float* data, uint16_t n) {
+  for (uint16_t i = 1, j = 0; i < n; i++) {
+    uint16_t bit = n >> 1;
+    for (; j & bit; bit >>= 1) j ^= bit;
+    j ^= bit;
+    if (i < j) {
+      float tr = data[2 * i], ti = data[2 * i + 1];
+      data[2 * i] = data[2 * j];
+      data[2 * i + 1] = data[2 * j + 1];
+      data[2 * j] = tr;
+      data[2 * j + 1] = ti;
+    }
+  }
+
+  for (uint16_t len = 2; len <= n; len <<= 1) {
+    float ang = -2 * PI / len;
+    for (uint16_t i = 0; i < n; i += len) {
+      for (uint16_t k = 0; k < len / 2; k++) {
+        float wr = cosf(ang * k), wi = sinf(ang * k);
+        uint16_t a = 2 * (i + k), b = 2 * (i + k + len / 2);
+        float xr = data[b] * wr - data[b + 1] * wi;
+        float xi = data[b] * wi + data[b + 1] * wr;
+        data[b] = data[a] - xr;
+        data[b + 1] = data[a + 1] - xi;
+        data[a] += xr;
+        data[a + 1] += xi;
+      }
+    }
+  }
+}
+#endif
+
+// Burst statistics and band energies into stormPkt
+void summariseStorm() {
+  const float mAPerLsb = INA219_SHUNT_UA_PER_LSB / 1000.0;
+  float* x = stormBuffer + STORM_SAMPLES;        // Upper half: real samples (mA)
+
+  // One scalar pass: convert, sum, min, max
+  int16_t lo = INT16_MAX;
+  int16_t hi = INT16_MIN;
+  float sum = 0;
+  for (uint16_t i = 0; i < STORM_SAMPLES; i++) {
+    int16_t v = abs(stormSamples[i]);
+    if (v < lo) lo = v;
+    if (v > hi) hi = v;
+    x[i] = v * mAPerLsb;
+    sum += x[i];
+  }
+  float mean = sum / STORM_SAMPLES;
+
+  // Remove the mean, then variance = x.x / N
+  float sumSq = 0;
+  #if STORM_USE_ESP_DSP
+    dsps_addc_f32(x, x, STORM_SAMPLES, -mean, 1, 1);
+    dsps_dotprod_f32(x, x, &sumSq, STORM_SAMPLES);
+  #else
+    for (uint16_t i = 0; i < STORM_SAMPLES; i++) {
+      x[i] -= mean;
+      sumSq += x[i] * x[i];
+    }
+  #endif
+  float sd = sqrtf(sumSq / STORM_SAMPLES);
+
+  // Windowed samples into the complex buffer (imaginary parts zero). The
+  // real samples sit in the upper half, which the forward fill overwrites
+  // only after reading them.
+  #if STORM_USE_ESP_DSP
+    dsps_mul_f32(x, stormWindow, x, STORM_SAMPLES, 1, 1, 1);
+  #else
+    for (uint16_t i = 0; i < STORM_SAMPLES; i++) x[i] *= stormWindow[i];
+  #endif
+  for (uint16_t i = 0; i < STORM_SAMPLES; i++) {
+    float v = x[i];
+    stormBuffer[2 * i] = v;
+    stormBuffer[2 * i + 1] = 0;
+  }
+
+  #if STORM_USE_ESP_DSP
+    dsps_fft2r_fc32(stormBuffer, STORM_SAMPLES);
+    dsps_bit_rev_fc32(stormBuffer, STORM_SAMPLES);
+  #else
+    stormFft(stormBuffer, STORM_SAMPLES);
+  #endif
+
+  // One-sided power per bin, scaled so the bins sum to the variance (mA^2)
+  const float binHz = (float)STORM_SAMPLE_HZ / STORM_SAMPLES;
+  const float scale = 2.0 / ((float)STORM_SAMPLES * STORM_SAMPLES * STORM_HANN_POWER);
+
+  memset(&stormPkt, 0, sizeof(StormPacket));
+  for (uint8_t b = 0; b < STORM_BANDS; b++) {
+    uint16_t k0 = ceilf(STORM_BAND_EDGES_DHZ[b] / 10.0 / binHz);
+    uint16_t k1 = min((uint16_t)ceilf(STORM_BAND_EDGES_DHZ[b + 1] / 10.0 / binHz), (uint16_t)(STORM_SAMPLES / 2));
+
+    float energy = 0;
+    for (uint16_t k = k0; k < k1; k++) {
+      float re = stormBuffer[2 * k];
+      float im = stormBuffer[2 * k + 1];
+      energy += (re * re + im * im) * scale;
+    }
+
+    // dB re 1 uA^2
+    float db = energy > 0 ? 10 * log10f(energy * 1e6) : 0;
+    stormPkt.bandDb[b] = (uint8_t)constrain(lroundf(db), 0, 255);
+  }
+
+  stormPkt.msgType = MSG_TYPE_STORM;
+  stormPkt.sourceId = NODE_ID;
+  stormPkt.relayId = 0;
+  stormPkt.mean_cmA = (uint16_t)constrain(lroundf(mean * 100.0), 0, 65535);
+  stormPkt.sd_cmA = (uint8_t)constrain(lroundf(sd * 100.0), 0, 255);
+  stormPkt.minBelow_5cmA = (uint8_t)constrain(lroundf((mean - lo * mAPerLsb) * 20.0), 0, 255);
+  stormPkt.maxAbove_5cmA = (uint8_t)constrain(lroundf((hi * mAPerLsb - mean) * 20.0), 0, 255);
+  stormPkt.rssi = 0;
+
+  Serial.print("Storm burst: mean ");
+  Serial.print(mean, 2);
+  Serial.print(" mA, SD ");
+  Serial.print(sd, 3);
+  Serial.print(" mA, range ");
+  Serial.print(lo * mAPerLsb, 2);
+  Serial.print("-");
+  Serial.print(hi * mAPerLsb, 2);
+  Serial.print(" mA, bands");
+  for (uint8_t b = 0; b < STORM_BANDS; b++) {
+    Serial.print(" ");
+    Serial.print(STORM_BAND_NAMES[b]);
+    Serial.print("=");
+    Serial.print(stormPkt.bandDb[b]);
+  }
+  Serial.println(" dB");
+}
+
+// Send the storm summary once CHANNEL_TX_DELAY_MS has passed
+void serviceStormTransmit(unsigned long now) {
+  if (!stormTxPending || txBusy || (long)(now - stormTxTime) < 0) return;
+  stormTxPending = false;
+
+  Serial.print("TX Storm #");
+  Serial.print(stormPkt.sequence);
+  Serial.print(" ... ");
+
+  startPacketTransmit(packetEncode(&stormPkt), packetLength(&stormPkt), stormPkt.msgType, stormPkt.sequence);
+}
+
+// Consume a pending rain-onset interrupt.
+// Returns true if it should trigger an immediate out-of-cycle reading.
+bool serviceRainOnset(unsigned long now) {
+  if (!rainOnsetFlag) return false;
+  rainOnsetFlag = false;
+
+  if (rainOnsetReported && now - lastRainOnsetTime < RAIN_ONSET_HOLDOFF_MS) return false;
+  rainOnsetReported = true;
+  lastRainOnsetTime = now;
+
+  Serial.println("Rain onset (LM393 DO) - reading now");
+  return true;
+}
+
+// Light sleep until the slot timer is next due or the LM393 DO pin goes low.
+// esp_timer keeps time through light sleep, so the schedule is unaffected.
+void idleSleep() {
+  int64_t idleUs = esp_timer_get_next_alarm() - esp_timer_get_time();
+  if (slotDue || idleUs < (int64_t)LIGHT_SLEEP_MIN_MS * 1000) {
+    delay(1);
+    return;
+  }
+
+  esp_sleep_enable_timer_wakeup((uint64_t)idleUs);
+
+  // GPIO wake is level triggered: only arm it while the sensor is still dry,
+  // otherwise a wet sensor would wake us again immediately
+  bool armRainWake = RAIN_ONSET_ENABLED && digitalRead(RAIN_DO_PIN) == HIGH;
+  if (armRainWake) {
+    detachInterrupt(digitalPinToInterrupt(RAIN_DO_PIN));
+    gpio_wakeup_enable((gpio_num_t)RAIN_DO_PIN, GPIO_INTR_LOW_LEVEL);
+    esp_sleep_enable_gpio_wakeup();
+  }
+
+  Serial.flush();
+  esp_light_sleep_start();
+
+  if (armRainWake) {
+    gpio_wakeup_disable((gpio_num_t)RAIN_DO_PIN);
+    esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_GPIO);
+    attachInterrupt(digitalPinToInterrupt(RAIN_DO_PIN), onRainOnset, FALLING);
+    if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_GPIO) {
+      rainOnsetFlag = true;
+    }
+  }
+  esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_TIMER);
+}
+
+// ===== SELF-DIAGNOSTICS =====
+
+// Run this cycle's reading through the fault detectors
+void updateDiagnostics() {
+  bool rainWet = false;
+  #if RAIN_ONSET_ENABLED
+    rainWet = digitalRead(RAIN_DO_PIN) == LOW;
+  #endif
+
+  uint16_t previous = diagFaults;
+  diagFaults = diagUpdate(&sensorDiag, ina219Available, lastRawCurrent, lastMoistureRaw, rainWet);
+
+  if (diagFaults != previous) {
+    Serial.print("Diagnostics: ");
+    printFaults(diagFaults);
+  }
+}
+
+void printFaults(uint16_t faults) {
+  if (faults == 0) {
+    Serial.println("OK");
+    return;
+  }
+  for (uint8_t i = 0; i < DIAG_FAULT_COUNT; i++) {
+    if (!(faults & (1 << i))) continue;
+    Serial.print(DIAG_FAULT_NAMES[i]);
+    faults &= ~(1 << i);
+    Serial.print(faults ? ", " : "\n");
+  }
+}
+
+// ===== BATTERY GAUGE =====
+
+// Update the fuel gauge from VBAT and the charge drawn since the last update.
+// Called between cycles, never while a packet is on air, so the IR
+// compensation only has to cover the idle load.
+void updateBatteryGauge() {
+  #if BATTERY_GAUGE
+    if (txBusy) return;
+
+    // Battery current: measured if there is a battery INA219, else modelled
+    float load_mA = BATTERY_AWAKE_MA;
+    uint16_t raw;
+    if (batteryMonitorAvailable && readINA219Register(BATTERY_INA219_ADDR, INA219_REG_SHUNT, &raw)) {
+      load_mA = (int16_t)raw * 0.01 / BATTERY_SHUNT_OHMS;
+    }
+
+    uint32_t totalMv = 0;
+    for (uint8_t i = 0; i < VBAT_SAMPLE_COUNT; i++) {
+      totalMv += analogReadMilliVolts(VBAT_ADC_PIN);
+    }
+    int32_t terminal_mV = lroundf(totalMv * VBAT_DIVIDER * VBAT_CAL_SCALE / VBAT_SAMPLE_COUNT);
+
+    // Charge since the last update: awake at load_mA, asleep at
+    // BATTERY_SLEEP_MA, plus the extra draw of each transmit
+    int64_t nowUs = rtcTimeUs();
+    float elapsedH = batteryGauge.primed ? (nowUs - batteryLastUs) / 3.6e9 : 0;
+    float awakeH = elapsedH;
+    #if RIVER_DEEP_SLEEP
+      awakeH = min(elapsedH, (batteryAwakeMs + millis() - batteryMarkMs) / 3.6e6f);
+    #endif
+    float charge_mAh = load_mA * awakeH + BATTERY_SLEEP_MA * (elapsedH - awakeH) +
+                       BATTERY_TX_MA * batteryAirtimeMs / 3.6e6;
+
+    batteryUpdate(&batteryGauge, terminal_mV, load_mA, charge_mAh, elapsedH,
+                  BATTERY_CAPACITY_MAH, BATTERY_INTERNAL_MOHM);
+    batteryLastUs = nowUs;
+    batteryAirtimeMs = 0;
+    batteryAwakeMs = 0;
+    batteryMarkMs = millis();
+
+    batteryLevel = batteryPercent(&batteryGauge);
+    batteryLow = batteryLevel < BATTERY_LOW_PERCENT;
+  #endif
+}
+
+// Feed the latest reading to the reporting policy.
+// Returns why it should be transmitted, or NULL to stay silent.
+const char* checkReportPolicy() {
+  uint32_t nowMs = (uint32_t)(rtcTimeUs() / 1000);
+  int32_t depthMm = ina219Available ? calDepthMm(depthCal, lroundf(lastCurrent * 1000.0)) : 0;
+
+  // Rate of change between consecutive readings, smoothed
+  if (ina219Available) {
+    if (ratePrimed && nowMs != rateTimeMs) {
+      float rate = (depthMm - rateDepthMm) * 60000.0 / (int32_t)(nowMs - rateTimeMs);
+      depthRateMmMin += (rate - depthRateMmMin) / (1 << REPORT_RATE_SHIFT);
+    }
+    rateDepthMm = depthMm;
+    rateTimeMs = nowMs;
+    ratePrimed = true;
+  }
+
+  if (forceReport) return "event";
+  if (!reportPrimed) return "unsent";
+  if (diagFaults != lastReportFaults) return "fault";
+  if (ina219Available && abs(depthMm - lastReportDepthMm) >= REPORT_DEPTH_DEADBAND_MM) return "depth";
+  if (fabs(lastMoisturePercent - lastReportMoisture) >= REPORT_MOISTURE_DEADBAND) return "moisture";
+
+  float rate = fabs(depthRateMmMin);
+  uint32_t maxSilenceMs = rate >= REPORT_FLOOD_RATE_MM_MIN ? REPORT_FAST_INTERVAL_MS :
+                          rate >= REPORT_ACTIVE_RATE_MM_MIN ? REPORT_ACTIVE_INTERVAL_MS :
+                          REPORT_HEARTBEAT_MS;
+
+  // Low battery: stretch every silence limit to save energy
+  if (batteryLow) maxSilenceMs *= 2;
+
+  // Half a slot of slack so slot jitter can't push a report a whole slot late
+  if (nowMs - lastReportTimeMs + slotIntervalMs / 2 >= maxSilenceMs) {
+    return rate >= REPORT_ACTIVE_RATE_MM_MIN ? "rate" : "heartbeat";
+  }
+  return NULL;
+}
+
+// Remember what the receivers last saw
+void noteReported(int32_t depthMm, float moisturePercent) {
+  reportPrimed = true;
+  forceReport = false;
+  lastReportDepthMm = depthMm;
+  lastReportMoisture = moisturePercent;
+  lastReportTimeMs = (uint32_t)(rtcTimeUs() / 1000);
+  lastReportFaults = diagFaults;
+}
+
+void reportReading(const char* reportWhy) {
   float avgCurrent = 0.0;
   float depthCm = 0.0;
   float depthInches = 0.0;
   float depthPercent = 0.0;
 
-  // Read INA219 if available
   if (ina219Available) {
-    avgCurrent = getAverageCurrent();
+    avgCurrent = lastCurrent;
     depthCm = calculateDepth(avgCurrent);
     depthInches = depthCm * CM_TO_INCHES;
     depthPercent = calculatePercentage(avgCurrent);
   }
 
-  // Read soil moisture sensor (only every MOISTURE_READ_INTERVAL_MS)
-  unsigned long currentTime = millis();
-  if (currentTime - lastMoistureReadTime >= MOISTURE_READ_INTERVAL_MS || lastMoistureReadTime == 0) {
-    lastMoistureRaw = getAverageMoisture();
-    lastMoisturePercent = calculateMoisturePercent(lastMoistureRaw);
-    lastMoistureReadTime = currentTime;
-  }
   int moistureRaw = lastMoistureRaw;
   float moisturePercent = lastMoisturePercent;
 
@@ -281,6 +2007,18 @@ void loop() {
     Serial.print(avgCurrent, 2);
     Serial.println(" mA");
 
+    for (uint8_t i = 1; i < channelCount; i++) {
+      Serial.print("  Ch");
+      Serial.print(i);
+      Serial.print(" (0x");
+      Serial.print(channelAddr[i], HEX);
+      Serial.print("): ");
+      Serial.print(lastChannelCurrent[i], 2);
+      Serial.print(" mA, ");
+      Serial.print(calculateDepth(lastChannelCurrent[i]), 1);
+      Serial.println(" cm");
+    }
+
     Serial.print("Depth: ");
     if (depthInches >= 12.0) {
       Serial.print(feet);
@@ -293,12 +2031,6 @@ void loop() {
     }
     Serial.print(depthPercent, 1);
     Serial.println("%)");
-
-    if (avgCurrent < MIN_CURRENT_MA - 0.5) {
-      Serial.println("WARNING: Current below 4mA!");
-    } else if (avgCurrent > MAX_CURRENT_MA + 0.5) {
-      Serial.println("WARNING: Current above 20mA!");
-    }
   } else {
     Serial.println("Water level: N/A (INA219 not connected)");
   }
@@ -309,55 +2041,293 @@ void loop() {
   Serial.print(moistureRaw);
   Serial.println(")");
 
-  // Transmit via LoRa
-  bool txSuccess = transmitSensorData(avgCurrent, moisturePercent);
+  if (diagFaults) {
+    Serial.print("FAULTS: ");
+    printFaults(diagFaults);
+  }
+
+  if (slotOverruns > 0) {
+    Serial.print("TX slot overruns: ");
+    Serial.println(slotOverruns);
+  }
+
+  Serial.print("Rate: ");
+  Serial.print(depthRateMmMin, 1);
+  Serial.println(" mm/min");
+
+  #if BATTERY_GAUGE
+    Serial.print("Battery: ");
+    Serial.print(batteryGauge.terminal_mV / 1000.0, 2);
+    Serial.print(" V (OCV ");
+    Serial.print(batteryGauge.ocv_mV / 1000.0, 2);
+    Serial.print(" V), ");
+    Serial.print(batteryLevel);
+    Serial.print("%, ~");
+    Serial.print(batteryRuntimeHours(&batteryGauge, BATTERY_CAPACITY_MAH), 0);
+    Serial.print(" h at ");
+    Serial.print(batteryGauge.avgLoad_mA, 1);
+    Serial.println(batteryLow ? " mA - LOW" : " mA");
+  #endif
+
+  // Start the LoRa transmit, then draw the display while it is on air
+  if (reportWhy || batchFull()) {
+    Serial.print("Report (");
+    Serial.print(reportWhy ? reportWhy : "batch");
+    Serial.print("): ");
+    #if BATCH_UPLINK
+      bool started = transmitBatch();
+    #else
+      bool started = transmitSensorData(avgCurrent, moisturePercent);
+    #endif
+    if (started) {
+      noteReported(lroundf(depthCm * 10.0), moisturePercent);
+    } else {
+      // Nothing went out: the readings stay queued and the report is
+      // resent next cycle, as after a TX that fails on air
+      loraTxOk = false;
+      reportPrimed = false;
+    }
+  } else if (BATCH_UPLINK) {
+    Serial.print("Queued for batch (");
+    Serial.print(readingsSinceTx);
+    Serial.print("/");
+    Serial.print(BATCH_READINGS);
+    Serial.println(")");
+  } else {
+    Serial.println("Within deadband - not sent");
+  }
 
   Serial.println();
 
   // Update OLED display
-  updateOLEDDisplay(avgCurrent, depthInches, depthPercent, moisturePercent, ina219Available, txSuccess);
+  if (displayReady) {
+    updateOLEDDisplay(avgCurrent, depthInches, depthPercent, moisturePercent, ina219Available);
+  }
+}
 
-  // Wait before next reading
-  delay(10000);
+void startCurrentSampling(unsigned long now) {
+  currentSampleIndex = 0;
+  currentCycleStart = now;
+  currentSampling = true;
+
+  #if INA219_HW_AVERAGING
+    // Writing the config register triggers one averaged conversion;
+    // every channel converts in parallel and each result is collected
+    // once that channel's conversion-ready bit is set
+    // (a failed trigger is caught by the timeout fallback)
+    currentPendingMask = 0;
+    for (uint8_t i = 0; i < channelCount; i++) {
+      writeINA219Register(channelAddr[i], INA219_REG_CFG, INA219_CFG_TRIGGER_128S);
+      currentPendingMask |= 1 << i;
+    }
+    nextCurrentSampleTime = now + INA219_CONVERSION_MS;
+  #else
+    nextCurrentSampleTime = now;
+  #endif
 }
 
-float getAverageCurrent() {
-  float total = 0.0;
+// Take the next INA219 samples if due and feed them through the filters.
+// One pass covers every channel on the bus.
+// Returns true when the filtered values for this cycle have been published.
+bool serviceCurrentSampling(unsigned long now) {
+  if (!currentSampling || (long)(now - nextCurrentSampleTime) < 0) return false;
+
+  #if INA219_HW_AVERAGING
+    bool timedOut = now - currentCycleStart >= INA219_CONVERSION_TIMEOUT_MS;
+
+    for (uint8_t i = 0; i < channelCount; i++) {
+      if (!(currentPendingMask & (1 << i))) continue;
+
+      uint16_t bus = 0;
+      uint16_t shunt = 0;
+
+      if (readINA219Register(channelAddr[i], INA219_REG_BUS, &bus) && (bus & INA219_BUS_CNVR)) {
+        readINA219Register(channelAddr[i], INA219_REG_SHUNT, &shunt);
+        addCurrentSample(i, abs((int16_t)shunt) * INA219_SHUNT_UA_PER_LSB);
+        currentPendingMask &= ~(1 << i);
+      } else if (timedOut) {
+        // Conversion never completed - fall back to a single direct read
+        Serial.print("INA219 conversion timeout on 0x");
+        Serial.println(channelAddr[i], HEX);
+        addCurrentSample(i, lroundf(abs(channelSensor[i]->getCurrent_mA()) * 1000.0));
+        currentPendingMask &= ~(1 << i);
+      }
+    }
 
-  for (int i = 0; i < SAMPLE_COUNT; i++) {
-    float current_mA = ina219.getCurrent_mA();
-    current_mA = abs(current_mA);
-    total += current_mA;
+    if (currentPendingMask) {
+      nextCurrentSampleTime = now + INA219_READY_POLL_MS;
+      return false;
+    }
+  #else
+    for (uint8_t i = 0; i < channelCount; i++) {
+      float current_mA = channelSensor[i]->getCurrent_mA();
+      addCurrentSample(i, lroundf(abs(current_mA) * 1000.0));
+    }
+    currentSampleIndex++;
 
-    if (i < SAMPLE_COUNT - 1) {
-      delay(SAMPLE_DELAY_MS);
+    if (currentSampleIndex < SAMPLE_COUNT) {
+      nextCurrentSampleTime += SAMPLE_DELAY_MS;
+      return false;
     }
+  #endif
+
+  for (uint8_t i = 0; i < channelCount; i++) {
+    lastChannelCurrent[i] = filterValue(&currentFilter[i]) / 1000.0;
   }
+  lastCurrent = lastChannelCurrent[0];
+  currentSampling = false;
+  return true;
+}
 
-  return total / SAMPLE_COUNT;
+// Feed one sample to a channel's filter (channel 0 is also kept raw for
+// the jump detector, which the median would otherwise hide)
+void addCurrentSample(uint8_t ch, int32_t current_uA) {
+  filterUpdate(&currentFilter[ch], current_uA);
+  if (ch == 0) {
+    lastRawCurrent = current_uA / 1000.0;
+  }
+}
+
+bool writeINA219Register(uint8_t addr, uint8_t reg, uint16_t value) {
+  I2C_INA219.beginTransmission(addr);
+  I2C_INA219.write(reg);
+  I2C_INA219.write((uint8_t)(value >> 8));
+  I2C_INA219.write((uint8_t)(value & 0xFF));
+  return I2C_INA219.endTransmission() == 0;
+}
+
+bool readINA219Register(uint8_t addr, uint8_t reg, uint16_t* value) {
+  I2C_INA219.beginTransmission(addr);
+  I2C_INA219.write(reg);
+  if (I2C_INA219.endTransmission() != 0) return false;
+
+  if (I2C_INA219.requestFrom(addr, (uint8_t)2) != 2) return false;
+  uint8_t msb = I2C_INA219.read();
+  uint8_t lsb = I2C_INA219.read();
+  *value = ((uint16_t)msb << 8) | lsb;
+  return true;
 }
 
 float calculateDepth(float current_mA) {
-  current_mA = constrain(current_mA, MIN_CURRENT_MA, MAX_CURRENT_MA);
-  float depth = ((current_mA - MIN_CURRENT_MA) / (MAX_CURRENT_MA - MIN_CURRENT_MA)) * MAX_DEPTH_CM;
-  return depth;
+  return calDepthMm(depthCal, lroundf(current_mA * 1000.0)) / 10.0;
 }
 
 float calculatePercentage(float current_mA) {
-  current_mA = constrain(current_mA, MIN_CURRENT_MA, MAX_CURRENT_MA);
-  float percentage = ((current_mA - MIN_CURRENT_MA) / (MAX_CURRENT_MA - MIN_CURRENT_MA)) * 100.0;
-  return percentage;
+  return calculateDepth(current_mA) * 1000.0 / calFullScaleMm(depthCal);
+}
+
+// Read serial commands without blocking (one line at a time)
+void serviceSerialCommands() {
+  static char line[48];
+  static uint8_t len = 0;
+
+  while (Serial.available()) {
+    char c = Serial.read();
+    if (c == '\r' || c == '\n') {
+      if (len == 0) continue;
+      line[len] = '\0';
+      len = 0;
+      if (!calHandleCommand(&depthCal, line, ina219Available ? lroundf(lastCurrent * 1000.0) : -1)) {
+        Serial.print("Unknown command: ");
+        Serial.println(line);
+      }
+    } else if (len < sizeof(line) - 1) {
+      line[len++] = toupper(c);
+    }
+  }
+}
+
+void startMoistureSampling(unsigned long now) {
+  moistureTotal = 0;
+  moistureSampleIndex = 0;
+  nextMoistureSampleTime = now;
+  moistureCycleStart = now;
+  moistureSampling = true;
+
+  #if MOISTURE_POWER_GATING
+    // Power the probe and let its output settle before the first sample
+    setMoistureProbePower(true);
+    moistureSettling = true;
+    nextMoistureSampleTime = now + MOISTURE_SETTLE_MS;
+  #else
+    beginMoistureAcquisition(now);
+  #endif
 }
 
-int getAverageMoisture() {
-  long total = 0;
+// Start the ADC side of a moisture reading once the probe is powered
+void beginMoistureAcquisition(unsigned long now) {
+  nextMoistureSampleTime = now;
+  moistureCycleStart = now;
+
+  #if MOISTURE_DMA_ADC
+    // The ADC driver fills one DMA frame and averages it without the CPU;
+    // if continuous mode can't start, this cycle falls back to analogRead()
+    static const uint8_t moisturePins[] = { MOISTURE_SENSOR_PIN };
+    moistureFrameReady = false;
+    moistureDmaActive = analogContinuous(moisturePins, 1, MOISTURE_DMA_CONVERSIONS,
+                                         MOISTURE_DMA_SAMPLE_HZ, &onMoistureFrame) &&
+                        analogContinuousStart();
+    if (!moistureDmaActive) {
+      Serial.println("Continuous ADC failed - using analogRead()");
+      analogContinuousDeinit();
+    }
+  #endif
+}
 
-  for (int i = 0; i < MOISTURE_SAMPLE_COUNT; i++) {
-    total += analogRead(MOISTURE_SENSOR_PIN);
-    delay(10);
+// Switch the LM393 supply (no-op unless MOISTURE_POWER_GATING)
+void setMoistureProbePower(bool on) {
+  #if MOISTURE_POWER_GATING
+    digitalWrite(MOISTURE_POWER_PIN, on ? HIGH : LOW);
+  #endif
+}
+
+// Take the next moisture ADC sample if one is due.
+// Returns true when the average for this cycle has been published.
+bool serviceMoistureSampling(unsigned long now) {
+  if (!moistureSampling || (long)(now - nextMoistureSampleTime) < 0) return false;
+
+  if (moistureSettling) {
+    moistureSettling = false;
+    beginMoistureAcquisition(now);
+    return false;
+  }
+
+  #if MOISTURE_DMA_ADC
+    if (moistureDmaActive) {
+      if (!moistureFrameReady && now - moistureCycleStart < MOISTURE_DMA_TIMEOUT_MS) return false;
+
+      adc_continuous_data_t* result = NULL;
+      if (moistureFrameReady && analogContinuousRead(&result, 0)) {
+        lastMoistureRaw = result[0].avg_read_raw;
+      } else {
+        Serial.println("Moisture ADC frame timeout - keeping last reading");
+      }
+
+      // Release the ADC unit between readings
+      analogContinuousStop();
+      analogContinuousDeinit();
+      moistureDmaActive = false;
+
+      lastMoisturePercent = calculateMoisturePercent(lastMoistureRaw);
+      setMoistureProbePower(false);
+      moistureSampling = false;
+      return true;
+    }
+  #endif
+
+  moistureTotal += analogRead(MOISTURE_SENSOR_PIN);
+  moistureSampleIndex++;
+
+  if (moistureSampleIndex < MOISTURE_SAMPLE_COUNT) {
+    nextMoistureSampleTime += MOISTURE_SAMPLE_DELAY_MS;
+    return false;
   }
 
-  return total / MOISTURE_SAMPLE_COUNT;
+  lastMoistureRaw = moistureTotal / MOISTURE_SAMPLE_COUNT;
+  lastMoisturePercent = calculateMoisturePercent(lastMoistureRaw);
+  setMoistureProbePower(false);
+  moistureSampling = false;
+  return true;
 }
 
 float calculateMoisturePercent(int rawValue) {
@@ -367,21 +2337,33 @@ float calculateMoisturePercent(int rawValue) {
   return percentage;
 }
 
-void updateOLEDDisplay(float current_mA, float depthInches, float percentage, float moisturePercent, bool hasWaterLevel, bool loraTxOk) {
-  display.clearDisplay();
+// Header with LoRa status ("TX:.." while the packet is on air)
+void drawStatusHeader() {
+  display.fillRect(0, 0, SCREEN_WIDTH, 10, SSD1306_BLACK);
   display.setTextSize(1);
   display.setTextColor(SSD1306_WHITE);
-
-  // Header with LoRa status
   display.setCursor(0, 0);
   display.print("RIVER ");
-  if (loraTxOk) {
+  if (txBusy && (txMsgType == MSG_TYPE_SENSOR || txMsgType == MSG_TYPE_BATCH)) {
+    display.print("TX:..");
+  } else if (loraTxOk) {
     display.print("TX:OK");
   } else {
     display.print("TX:--");
   }
   display.print(" #");
   display.print(packetSequence - 1);
+  if (diagFaults) {
+    display.print(" FLT");
+  }
+}
+
+void updateOLEDDisplay(float current_mA, float depthInches, float percentage, float moisturePercent, bool hasWaterLevel) {
+  display.clearDisplay();
+  display.setTextSize(1);
+  display.setTextColor(SSD1306_WHITE);
+
+  drawStatusHeader();
   display.drawLine(0, 10, SCREEN_WIDTH, 10, SSD1306_WHITE);
 
   if (hasWaterLevel) {
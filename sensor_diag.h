@@ -0,0 +1,159 @@
+/*
+ * Sensor Diagnostics - Incremental fault detection for the river unit
+ *
+ * Used by the river unit. The copy in river_unit/ must match this file.
+ * Fault bits (DIAG_*) are part of the packet format and live in
+ * lora_config.h.
+ *
+ * diagUpdate() takes one reading per cycle and is O(1) in time and state.
+ * Each signal keeps exponentially weighted rolling statistics:
+ *   mean += a * d
+ *   var   = (1 - a) * (var + a * d^2)       d = x - mean, a = 1 / 2^shift
+ * which give:
+ *   - stuck value: rolling variance below the sensor's quantisation noise
+ *     after warm-up, while the current sits outside the live 4-20 mA band.
+ *     Flat alone is not a fault: the INA219 averages 128 samples, so a
+ *     healthy loop on a calm river returns the same code cycle after cycle.
+ *     A transmitter pinned at a rail (NE43 failure signal, saturated
+ *     driver) is both flat and out of band.
+ *   - implausible jump: rolling z-score |d| / sqrt(var) above DIAG_JUMP_Z,
+ *     with a minimum absolute step so a quiet channel can't trip on one LSB
+ * The moisture probe's dry rail (4095) is also its reading in plain dry
+ * soil, so dry-stuck needs the rain comparator to disagree: the analog
+ * side reads dry while DO reports wet.
+ * Level faults (open loop, over-range, saturated probe, dry-stuck) must
+ * persist for DIAG_CONFIRM readings; a jump is held for DIAG_JUMP_HOLD
+ * readings so a report-by-exception uplink still carries it.
+ */
+
+#ifndef SENSOR_DIAG_H
+#define SENSOR_DIAG_H
+
+#include <stdint.h>
+#include <math.h>
+#include "lora_config.h"
+
+// Loop current limits (NAMUR NE43 style)
+#define DIAG_LOOP_OPEN_MA       3.6f    // Below: broken loop or dead sensor
+#define DIAG_LOOP_OVER_MA       20.5f   // Above: over-range or shorted sensor
+
+#define DIAG_CONFIRM            2       // Readings a level fault must persist
+#define DIAG_WARMUP             32      // Readings before stuck/jump checks run
+#define DIAG_STUCK_SHIFT        6       // Variance window ~64 readings
+#define DIAG_CURRENT_STUCK_VAR  0.0001f // mA^2 - (0.01 mA)^2, well under one LSB
+#define DIAG_BAND_LOW_MA        3.9f    // Flat below this: pinned low
+#define DIAG_BAND_HIGH_MA       20.1f   // Flat above this: pinned high
+#define DIAG_JUMP_Z             6.0f
+#define DIAG_JUMP_MIN_MA        0.5f    // ~3% of the 4-20 mA span
+#define DIAG_JUMP_HOLD          3
+
+// Moisture (raw 12-bit ADC, LM393 reads high when dry)
+#define DIAG_MOIST_SAT_RAW      100     // At or below: probe shorted / saturated
+#define DIAG_MOIST_DRY_RAW      4000    // At or above: at the dry rail
+
+typedef struct {
+  float    mean;
+  float    var;
+  uint16_t n;       // Readings seen (saturates)
+} RollingStats;
+
+typedef struct {
+  RollingStats current;     // Loop current, mA
+  uint8_t  openCount;       // Consecutive readings per level fault
+  uint8_t  overCount;
+  uint8_t  satCount;
+  uint8_t  dryCount;
+  uint8_t  jumpHold;        // Readings left to report a jump
+  uint16_t faults;          // DIAG_* bits from the last update
+} SensorDiag;
+
+inline void statsInit(RollingStats* s) {
+  s->mean = 0;
+  s->var = 0;
+  s->n = 0;
+}
+
+// Add one value; returns its deviation from the mean before the update
+inline float statsUpdate(RollingStats* s, float x, uint8_t shift) {
+  if (s->n == 0) {
+    s->mean = x;
+    s->var = 0;
+    s->n = 1;
+    return 0;
+  }
+
+  float a = 1.0f / (1 << shift);
+  float d = x - s->mean;
+  s->mean += a * d;
+  s->var = (1.0f - a) * (s->var + a * d * d);
+  if (s->n < UINT16_MAX) s->n++;
+  return d;
+}
+
+inline void diagInit(SensorDiag* g) {
+  statsInit(&g->current);
+  g->openCount = 0;
+  g->overCount = 0;
+  g->satCount = 0;
+  g->dryCount = 0;
+  g->jumpHold = 0;
+  g->faults = 0;
+}
+
+// Count consecutive readings that meet a condition (saturating)
+inline bool diagConfirm(uint8_t* count, bool condition) {
+  if (!condition) {
+    *count = 0;
+    return false;
+  }
+  if (*count < UINT8_MAX) (*count)++;
+  return *count >= DIAG_CONFIRM;
+}
+
+// Feed one reading per cycle and return the active DIAG_* fault bits.
+//   hasCurrent  a loop current sensor is fitted
+//   rainWet     the rain onset comparator (DO) reports wet
+inline uint16_t diagUpdate(SensorDiag* g, bool hasCurrent, float current_mA,
+                           int moistureRaw, bool rainWet) {
+  uint16_t faults = 0;
+
+  if (!hasCurrent) {
+    faults |= DIAG_NO_CURRENT_SENSOR;
+  } else {
+    if (diagConfirm(&g->openCount, current_mA < DIAG_LOOP_OPEN_MA)) faults |= DIAG_LOOP_OPEN;
+    if (diagConfirm(&g->overCount, current_mA > DIAG_LOOP_OVER_MA)) faults |= DIAG_LOOP_OVER;
+
+    // z-score against the statistics before this reading
+    float sd = sqrtf(g->current.var);
+    bool warm = g->current.n >= DIAG_WARMUP;
+    float d = statsUpdate(&g->current, current_mA, DIAG_STUCK_SHIFT);
+
+    if (warm && fabsf(d) >= DIAG_JUMP_MIN_MA && fabsf(d) > DIAG_JUMP_Z * sd) {
+      g->jumpHold = DIAG_JUMP_HOLD;
+    }
+    if (g->jumpHold > 0) {
+      faults |= DIAG_CURRENT_JUMP;
+      g->jumpHold--;
+    }
+
+    // Flat and out of band. Open loop and over-range already report the
+    // far ends - report those, not a stuck sensor
+    bool outOfBand = current_mA < DIAG_BAND_LOW_MA || current_mA > DIAG_BAND_HIGH_MA;
+    if (warm && outOfBand && g->current.var < DIAG_CURRENT_STUCK_VAR &&
+        !(faults & (DIAG_LOOP_OPEN | DIAG_LOOP_OVER))) {
+      faults |= DIAG_CURRENT_STUCK;
+    }
+  }
+
+  if (diagConfirm(&g->satCount, moistureRaw <= DIAG_MOIST_SAT_RAW)) faults |= DIAG_MOISTURE_SATURATED;
+
+  // Analog side dry while the comparator says wet
+  if (diagConfirm(&g->dryCount, moistureRaw >= DIAG_MOIST_DRY_RAW && rainWet)) {
+    faults |= DIAG_MOISTURE_DRY_STUCK;
+  }
+
+  g->faults = faults;
+  return faults;
+}
+
+#endif // SENSOR_DIAG_H
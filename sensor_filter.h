@@ -0,0 +1,85 @@
+/*
+ * Sensor Filter - Fixed-point spike rejection and smoothing
+ *
+ * Shared by the standalone sketch, river unit and home unit.
+ * The copies in river_unit/ and home_unit/ must match this file.
+ *
+ * Each sample passes through two stages, both constant time and
+ * allocation-free:
+ *   1. Median of the last FILTER_MEDIAN_WINDOW samples (rejects spikes)
+ *   2. Exponentially weighted moving average of the median output:
+ *        y += (x - y) >> shift      (alpha = 1 / 2^shift)
+ *
+ * Values are plain integers; the sketches feed loop current in microamps,
+ * so a full 4-20 mA reading fits comfortably in the Q8 EWMA state.
+ */
+
+#ifndef SENSOR_FILTER_H
+#define SENSOR_FILTER_H
+
+#include <stdint.h>
+
+#define FILTER_MEDIAN_WINDOW  5      // Odd number of samples (3-9)
+#define FILTER_EWMA_FRAC_BITS 8      // EWMA state is Q8 fixed point
+
+typedef struct {
+  int32_t window[FILTER_MEDIAN_WINDOW];  // Ring buffer of raw samples
+  uint8_t head;                          // Next slot to overwrite
+  uint8_t count;                         // Valid samples in window
+  uint8_t shift;                         // EWMA alpha = 1 / 2^shift
+  bool    primed;                        // EWMA holds a value
+  int32_t ewma;                          // Smoothed value (Q8)
+} SensorFilter;
+
+// Reset filter state. shift = 0 disables smoothing (median only).
+inline void filterInit(SensorFilter* f, uint8_t shift) {
+  f->head = 0;
+  f->count = 0;
+  f->shift = shift;
+  f->primed = false;
+  f->ewma = 0;
+}
+
+// Median of the samples currently in the window
+inline int32_t filterMedian(const SensorFilter* f) {
+  int32_t sorted[FILTER_MEDIAN_WINDOW];
+  uint8_t n = f->count;
+
+  // Insertion sort - at most FILTER_MEDIAN_WINDOW elements
+  for (uint8_t i = 0; i < n; i++) {
+    int32_t v = f->window[i];
+    uint8_t j = i;
+    while (j > 0 && sorted[j - 1] > v) {
+      sorted[j] = sorted[j - 1];
+      j--;
+    }
+    sorted[j] = v;
+  }
+
+  return sorted[n / 2];
+}
+
+// Current filter output (rounded from Q8)
+inline int32_t filterValue(const SensorFilter* f) {
+  return (f->ewma + (1 << (FILTER_EWMA_FRAC_BITS - 1))) >> FILTER_EWMA_FRAC_BITS;
+}
+
+// Add one sample and return the filtered value
+inline int32_t filterUpdate(SensorFilter* f, int32_t sample) {
+  f->window[f->head] = sample;
+  f->head = (f->head + 1) % FILTER_MEDIAN_WINDOW;
+  if (f->count < FILTER_MEDIAN_WINDOW) f->count++;
+
+  int32_t median = filterMedian(f) << FILTER_EWMA_FRAC_BITS;
+
+  if (!f->primed) {
+    f->ewma = median;
+    f->primed = true;
+  } else {
+    f->ewma += (median - f->ewma) >> f->shift;
+  }
+
+  return filterValue(f);
+}
+
+#endif // SENSOR_FILTER_H
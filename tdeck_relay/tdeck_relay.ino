@@ -25,6 +25,7 @@
 #include <RadioLib.h>
 #include <Arduino_GFX_Library.h>
 #include "../lora_config.h"
+#include "../depth_calibration.h"
 
 // Color definitions (RGB565 format)
 #define BLACK   0x0000
@@ -101,6 +102,9 @@ RTC_DATA_ATTR int16_t lastRSSI = 0;
 RTC_DATA_ATTR float lastCurrent = 0;
 RTC_DATA_ATTR float lastMoisture = 0;
 
+// Depth calibration for the status display (default table or NVS copy)
+CalTable depthCal;
+
 // Create display using Arduino_GFX - all pins defined inline, no global config needed
 // T-Deck uses shared SPI bus for display and LoRa
 Arduino_DataBus *bus = new Arduino_ESP32SPI(
@@ -153,6 +157,9 @@ void IRAM_ATTR onInputDetected(void) {
 bool initLoRa();
 void initDisplay();
 void goToDeepSleep();
+bool relayChannelPacket(uint8_t* frame, size_t len, int rxRSSI);
+bool relayStormPacket(uint8_t* frame, size_t len, int rxRSSI);
+bool relayBatchFrame(uint8_t* frame, size_t len, int rxRSSI);
 void updateDisplay(bool hasData, int rssi, float current, float moisture, uint32_t relayed);
 float readBatteryVoltage();
 void setupInputInterrupts();
@@ -197,6 +204,8 @@ void setup() {
       break;
   }
 
+  calLoad(&depthCal);
+
   // Initialize display
   initDisplay();
 
@@ -224,24 +233,51 @@ void setup() {
   // Listen for incoming packets
   Serial.println("Listening for packets...");
   unsigned long startTime = millis();
+  unsigned long listenWindow = RELAY_LISTEN_MS;
   bool receivedPacket = false;
 
-  while (millis() - startTime < RELAY_LISTEN_MS) {
-    SensorPacket pkt;
-    int state = radio.receive((uint8_t*)&pkt, sizeof(SensorPacket));
+  while (millis() - startTime < listenWindow) {
+    RxFrame rx;
+    SensorPacket& pkt = rx.sensor;
+    int state = radio.receive(rx.bytes, sizeof(rx.bytes));
 
     if (state == RADIOLIB_ERR_NONE) {
       Serial.println("Packet received!");
 
-      // Validate checksum
-      if (!validateChecksum(&pkt)) {
+      // Batched readings - a StormPacket or ChannelPacket may still follow
+      size_t rxLen = radio.getPacketLength();
+      if (isBatchFrame(rx.bytes, rxLen)) {
+        if (relayBatchFrame(rx.bytes, rxLen, radio.getRSSI())) receivedPacket = true;
+        startTime = millis();
+        listenWindow = RELAY_FOLLOW_MS;
+        continue;
+      }
+
+      // Validate checksum (compact frames are expanded into pkt)
+      bool compact;
+      if (!unpackFrame(&pkt, rxLen, &compact)) {
         Serial.println("  Checksum invalid - discarding");
         continue;
       }
 
+      // Per-channel currents from a multi-INA219 river unit - always the
+      // last packet of the river unit's cycle
+      if (pkt.msgType == MSG_TYPE_CHANNELS && isSensorSource(pkt.sourceId) && pkt.relayId == 0) {
+        if (relayChannelPacket(rx.bytes, rxLen, radio.getRSSI())) receivedPacket = true;
+        break;
+      }
+
+      // Storm burst summary - a ChannelPacket may still follow
+      if (pkt.msgType == MSG_TYPE_STORM && isSensorSource(pkt.sourceId) && pkt.relayId == 0) {
+        if (relayStormPacket(rx.bytes, rxLen, radio.getRSSI())) receivedPacket = true;
+        startTime = millis();
+        listenWindow = RELAY_FOLLOW_MS;
+        continue;
+      }
+
       // Check if this is a sensor packet from the river
-      if (pkt.msgType != MSG_TYPE_SENSOR || pkt.sourceId != UNIT_ID_RIVER) {
-        Serial.println("  Not from river unit - discarding");
+      if (pkt.msgType != MSG_TYPE_SENSOR || !isSensorSource(pkt.sourceId)) {
+        Serial.println("  Not from a sensor node - discarding");
         continue;
       }
 
@@ -260,7 +296,7 @@ void setup() {
       Serial.print(", Current: ");
       Serial.print(pkt.current_mA, 2);
       Serial.print(" mA, Moisture: ");
-      Serial.print(pkt.moisturePercent, 1);
+      Serial.print(pkt.moisture_dPct / 10.0, 1);
       Serial.println("%");
       Serial.print("  RSSI: ");
       Serial.print(rxRSSI);
@@ -271,13 +307,12 @@ void setup() {
       // Store for display
       lastRSSI = rxRSSI;
       lastCurrent = pkt.current_mA;
-      lastMoisture = pkt.moisturePercent;
+      lastMoisture = pkt.moisture_dPct / 10.0;
 
       // Modify packet for relay - use RIDGE2 ID for secondary relay
       pkt.msgType = MSG_TYPE_RELAY;
       pkt.relayId = UNIT_ID_RIDGE2;  // Secondary relay ID
       pkt.rssi = rxRSSI;
-      pkt.checksum = calculateChecksum(&pkt);
 
       // STAGGERED DELAY - wait for primary relay to transmit first
       Serial.print("  Waiting ");
@@ -287,7 +322,12 @@ void setup() {
 
       // Retransmit
       Serial.print("  Relaying... ");
-      state = radio.transmit((uint8_t*)&pkt, sizeof(SensorPacket));
+      if (compact) {
+        uint8_t frame[COMPACT_RELAY_FRAME_LEN];
+        state = radio.transmit(frame, encodeCompactFrame(&pkt, frame));
+      } else {
+        state = radio.transmit(packetEncode(&pkt), packetLength(&pkt));
+      }
 
       if (state == RADIOLIB_ERR_NONE) {
         Serial.println("OK");
@@ -299,9 +339,13 @@ void setup() {
       }
 
       // Update display
-      updateDisplay(true, rxRSSI, pkt.current_mA, pkt.moisturePercent, packetsRelayed);
+      updateDisplay(true, rxRSSI, pkt.current_mA, pkt.moisture_dPct / 10.0, packetsRelayed);
 
-      break;  // Exit listen loop
+      // Keep listening briefly for a StormPacket or ChannelPacket, then exit
+      // the listen loop (with an implicit header nothing else can follow)
+      if (LORA_IMPLICIT_HEADER) break;
+      startTime = millis();
+      listenWindow = RELAY_FOLLOW_MS;
     }
 
     delay(10);
@@ -359,13 +403,20 @@ void loop() {
     if (rxFlag) {
       rxFlag = false;
 
-      SensorPacket pkt;
-      int state = radio.readData((uint8_t*)&pkt, sizeof(SensorPacket));
+      RxFrame rx;
+      SensorPacket& pkt = rx.sensor;
+      size_t rxLen = radio.getPacketLength();
+      int state = radio.readData(rx.bytes, sizeof(rx.bytes));
+
+      bool batch = state == RADIOLIB_ERR_NONE && isBatchFrame(rx.bytes, rxLen);
+      bool compact = false;
+      bool valid = state == RADIOLIB_ERR_NONE && !batch &&
+                   unpackFrame(&pkt, rxLen, &compact);
 
       if (state == RADIOLIB_ERR_NONE) {
-        if (validateChecksum(&pkt) &&
+        if (valid &&
             pkt.msgType == MSG_TYPE_SENSOR &&
-            pkt.sourceId == UNIT_ID_RIVER &&
+            isSensorSource(pkt.sourceId) &&
             pkt.relayId == 0) {
 
           int rxRSSI = radio.getRSSI();
@@ -377,7 +428,7 @@ void loop() {
           Serial.print(", Current: ");
           Serial.print(pkt.current_mA, 2);
           Serial.print(" mA, Moisture: ");
-          Serial.print(pkt.moisturePercent, 1);
+          Serial.print(pkt.moisture_dPct / 10.0, 1);
           Serial.println("%");
           Serial.print("  RSSI: ");
           Serial.print(rxRSSI);
@@ -387,13 +438,12 @@ void loop() {
 
           lastRSSI = rxRSSI;
           lastCurrent = pkt.current_mA;
-          lastMoisture = pkt.moisturePercent;
+          lastMoisture = pkt.moisture_dPct / 10.0;
 
           // Modify and relay with secondary ID
           pkt.msgType = MSG_TYPE_RELAY;
           pkt.relayId = UNIT_ID_RIDGE2;
           pkt.rssi = rxRSSI;
-          pkt.checksum = calculateChecksum(&pkt);
 
           // Staggered delay
           Serial.print("  Waiting ");
@@ -402,7 +452,12 @@ void loop() {
           delay(RELAY_DELAY_MS);
 
           Serial.print("  Relaying... ");
-          state = radio.transmit((uint8_t*)&pkt, sizeof(SensorPacket));
+          if (compact) {
+            uint8_t frame[COMPACT_RELAY_FRAME_LEN];
+            state = radio.transmit(frame, encodeCompactFrame(&pkt, frame));
+          } else {
+            state = radio.transmit(packetEncode(&pkt), packetLength(&pkt));
+          }
 
           if (state == RADIOLIB_ERR_NONE) {
             Serial.println("OK");
@@ -414,8 +469,20 @@ void loop() {
 
           // Only update display if screen is on
           if (screenOn) {
-            updateDisplay(true, rxRSSI, pkt.current_mA, pkt.moisturePercent, packetsRelayed);
+            updateDisplay(true, rxRSSI, pkt.current_mA, pkt.moisture_dPct / 10.0, packetsRelayed);
           }
+        } else if (valid &&
+                   pkt.msgType == MSG_TYPE_CHANNELS &&
+                   isSensorSource(pkt.sourceId) &&
+                   pkt.relayId == 0) {
+          relayChannelPacket(rx.bytes, rxLen, radio.getRSSI());
+        } else if (valid &&
+                   pkt.msgType == MSG_TYPE_STORM &&
+                   isSensorSource(pkt.sourceId) &&
+                   pkt.relayId == 0) {
+          relayStormPacket(rx.bytes, rxLen, radio.getRSSI());
+        } else if (batch) {
+          relayBatchFrame(rx.bytes, rxLen, radio.getRSSI());
         }
       }
 
@@ -426,6 +493,106 @@ void loop() {
   #endif
 }
 
+// Relay a ChannelPacket (extra INA219 channels) from the river unit
+bool relayChannelPacket(uint8_t* frame, size_t len, int rxRSSI) {
+  ChannelPacket* pkt = packetDecode<ChannelPacket>(frame, len);
+  if (!pkt) return false;
+
+  Serial.print("Channel packet received: Seq #");
+  Serial.print(pkt->sequence);
+  Serial.print(", ");
+  Serial.print(pkt->channelCount);
+  Serial.println(" channel(s)");
+
+  pkt->relayId = UNIT_ID_RIDGE2;
+  pkt->rssi = rxRSSI;
+
+  delay(RELAY_DELAY_MS);
+  Serial.print("  Relaying... ");
+  int state = radio.transmit(packetEncode(pkt), packetLength(pkt));
+
+  if (state == RADIOLIB_ERR_NONE) {
+    Serial.println("OK");
+    packetsRelayed++;
+    return true;
+  }
+
+  Serial.print("FAILED! Error: ");
+  Serial.println(state);
+  return false;
+}
+
+// Batched readings: relay fields go in place, the readings stay packed
+bool relayBatchFrame(uint8_t* frame, size_t len, int rxRSSI) {
+  SensorBatch batch;
+  if (!decodeBatchFrame(&batch, frame, len)) {
+    Serial.println("  Batch CRC invalid - discarding");
+    return false;
+  }
+  if (!isSensorSource(batch.sourceId) || batch.relayId != 0) {
+    Serial.println("  Not a direct batch from a sensor node - discarding");
+    return false;
+  }
+
+  const BatchReading* latest = &batch.readings[batch.count - 1];
+  lastRSSI = rxRSSI;
+  lastCurrent = latest->current_cmA / 100.0;
+  lastMoisture = latest->moisture / 2.0;
+
+  Serial.print("Batch packet received: Seq #");
+  Serial.print(batch.sequence);
+  Serial.print(", ");
+  Serial.print(batch.count);
+  Serial.print(" readings, latest ");
+  Serial.print(lastCurrent, 2);
+  Serial.println(" mA");
+
+  len = appendBatchRelay(frame, len, UNIT_ID_RIDGE2, rxRSSI);
+
+  delay(RELAY_DELAY_MS);
+  Serial.print("  Relaying... ");
+  int state = radio.transmit(frame, len);
+
+  if (state != RADIOLIB_ERR_NONE) {
+    Serial.print("FAILED! Error: ");
+    Serial.println(state);
+    return false;
+  }
+
+  Serial.println("OK");
+  packetsRelayed++;
+  if (screenOn) {
+    updateDisplay(true, rxRSSI, lastCurrent, lastMoisture, packetsRelayed);
+  }
+  return true;
+}
+
+// Relay a StormPacket (burst summary) from the river unit
+bool relayStormPacket(uint8_t* frame, size_t len, int rxRSSI) {
+  StormPacket* pkt = packetDecode<StormPacket>(frame, len);
+  if (!pkt) return false;
+
+  Serial.print("Storm packet received: Seq #");
+  Serial.println(pkt->sequence);
+
+  pkt->relayId = UNIT_ID_RIDGE2;
+  pkt->rssi = rxRSSI;
+
+  delay(RELAY_DELAY_MS);
+  Serial.print("  Relaying... ");
+  int state = radio.transmit(packetEncode(pkt), packetLength(pkt));
+
+  if (state == RADIOLIB_ERR_NONE) {
+    Serial.println("OK");
+    packetsRelayed++;
+    return true;
+  }
+
+  Serial.print("FAILED! Error: ");
+  Serial.println(state);
+  return false;
+}
+
 void initDisplay() {
   Serial.print("Initializing display... ");
 
@@ -466,6 +633,19 @@ bool initLoRa() {
     return false;
   }
 
+  // Implicit header: length, coding rate and CRC come from lora_config.h
+  #if LORA_IMPLICIT_HEADER
+    state = radio.implicitHeader(LORA_IMPLICIT_LEN);
+    if (state == RADIOLIB_ERR_NONE) {
+      state = radio.setCRC(LORA_CRC_BYTES);
+    }
+    if (state != RADIOLIB_ERR_NONE) {
+      Serial.print("FAILED! Implicit header error: ");
+      Serial.println(state);
+      return false;
+    }
+  #endif
+
   Serial.println("OK");
   Serial.print("  Frequency: ");
   Serial.print(LORA_FREQUENCY);
@@ -541,7 +721,7 @@ void updateDisplay(bool hasData, int rssi, float current, float moisture, uint32
     // Depth calculation
     float depthCm = 0;
     if (current >= 4.0) {
-      depthCm = ((current - 4.0) / (20.0 - 4.0)) * 100.0;
+      depthCm = calDepthMm(depthCal, lroundf(current * 1000.0)) / 10.0;
     }
     float depthInches = depthCm * 0.393701;
 